@@ -3,12 +3,23 @@
 IF NOT EXIST "build" mkdir build
 pushd build
 
-SET sources=..\examples\basic_print.c ..\examples\basic_file_print.c ..\examples\change_file_type.c ..\examples\change_number_conversion.c
+SET sources=..\examples\basic_print.c ..\examples\basic_file_print.c ..\examples\change_file_type.c ..\examples\change_number_conversion.c ..\examples\format_to_buffer.c ..\examples\forward_args.c ..\examples\multiple_sinks.c ..\examples\benchmark.c ..\examples\async_print.c ..\examples\binary_log.c ..\examples\binary_log_decoder.c ..\examples\thread_buffer.c ..\examples\thread_contention.c ..\examples\cpp_print.cpp
 
 cl /FC /nologo /std:c11 /permissive- /Fe"basic_print.exe" ..\examples\basic_print.c
 cl /FC /nologo /std:c11 /permissive- /Fe"basic_file_print.exe" ..\examples\basic_file_print.c
 cl /FC /nologo /std:c11 /permissive- /Fe"change_file_type.exe" ..\examples\change_file_type.c
 cl /FC /nologo /std:c11 /permissive- /Fe"change_number_converison.exe" ..\examples\change_number_conversion.c
+cl /FC /nologo /std:c11 /permissive- /Fe"format_to_buffer.exe" ..\examples\format_to_buffer.c
+cl /FC /nologo /std:c11 /permissive- /Fe"forward_args.exe" ..\examples\forward_args.c
+cl /FC /nologo /std:c11 /permissive- /Fe"multiple_sinks.exe" ..\examples\multiple_sinks.c
+cl /FC /nologo /std:c11 /permissive- /O2 /Fe"benchmark.exe" ..\examples\benchmark.c
+cl /FC /nologo /std:c11 /permissive- /O2 /Fe"thread_buffer.exe" ..\examples\thread_buffer.c
+cl /FC /nologo /std:c11 /permissive- /O2 /Fe"thread_contention.exe" ..\examples\thread_contention.c
+cl /FC /nologo /std:c11 /permissive- /O2 /DSAFE_PRINT_ATOMIC_RECORDS /Fe"thread_contention_atomic.exe" ..\examples\thread_contention.c
+cl /FC /nologo /std:c11 /permissive- /experimental:c11atomics /Fe"async_print.exe" ..\examples\async_print.c
+cl /FC /nologo /std:c11 /permissive- /Fe"binary_log.exe" ..\examples\binary_log.c
+cl /FC /nologo /std:c11 /permissive- /Fe"binary_log_decoder.exe" ..\examples\binary_log_decoder.c
+cl /FC /nologo /std:c++20 /permissive- /EHsc /Fe"cpp_print.exe" ..\examples\cpp_print.cpp
 
 popd
 
@@ -7,6 +7,20 @@ gcc -Wall -std=gnu11 -obasic_print ../examples/basic_print.c
 gcc -Wall -std=gnu11 -obasic_file_print ../examples/basic_file_print.c
 gcc -Wall -std=gnu11 -ochange_file_type ../examples/change_file_type.c
 gcc -Wall -std=gnu11 -ochange_number_conversion ../examples/change_number_conversion.c
+gcc -Wall -std=gnu11 -oformat_to_buffer ../examples/format_to_buffer.c
+gcc -Wall -std=gnu11 -oforward_args ../examples/forward_args.c
+gcc -Wall -std=gnu11 -omultiple_sinks ../examples/multiple_sinks.c
+gcc -Wall -std=gnu11 -ofd_output ../examples/fd_output.c
+gcc -Wall -std=gnu11 -pthread -oasync_print ../examples/async_print.c
+gcc -Wall -std=gnu11 -obinary_log ../examples/binary_log.c
+gcc -Wall -std=gnu11 -obinary_log_decoder ../examples/binary_log_decoder.c
+gcc -Wall -std=gnu11 -oflight_recorder ../examples/flight_recorder.c
+gcc -Wall -std=gnu11 -oflight_recorder_dump ../examples/flight_recorder_dump.c
+gcc -Wall -O2 -std=gnu11 -obenchmark ../examples/benchmark.c
+gcc -Wall -O2 -std=gnu11 -pthread -othread_buffer ../examples/thread_buffer.c
+gcc -Wall -O2 -std=gnu11 -pthread -othread_contention ../examples/thread_contention.c
+gcc -Wall -O2 -std=gnu11 -pthread -DSAFE_PRINT_ATOMIC_RECORDS -othread_contention_atomic ../examples/thread_contention.c
+g++ -Wall -std=c++20 -ocpp_print ../examples/cpp_print.cpp
 
 popd
 
@@ -0,0 +1,28 @@
+
+#define SAFE_PRINT_ASYNC
+#define SAFE_PRINT_IMPLEMENTATION
+#include "../safe_print.h"
+#define print safe_print_async
+
+
+int main(int argc, char **argv) {
+    // NOTE: Block the caller when the background thread can't keep up. Use SAFE_PRINT_ASYNC_DROP
+    //       or SAFE_PRINT_ASYNC_COUNT_DROPS to never wait.
+    if (!safe_print_async_start(SAFE_PRINT_ASYNC_BLOCK)) {
+        safe_print("Could not start the background thread.\n");
+        return 1;
+    }
+    
+    // NOTE: The format string has to stay valid until it is printed, string literals are fine.
+    //       String arguments are copied.
+    char name[32];
+    for (int i = 0; i < 10; i += 1) {
+        safe_print_buffer(name, sizeof(name), "worker-{}", i);
+        print("{min(10)} finished job {hex:upper}\n", name, i * 4099);
+    }
+    
+    // NOTE: Waits until everything was printed.
+    safe_print_async_stop();
+    
+    safe_print("Dropped records: {}\n", safe_print_async_dropped());
+}
@@ -0,0 +1,415 @@
+
+#define SAFE_PRINT_IMPLEMENTATION
+#include "../safe_print.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(_WIN32) || defined(WIN32)
+#define NULL_DEVICE "NUL"
+#else
+#define NULL_DEVICE "/dev/null"
+#endif
+
+
+/*
+ * Small microbenchmarks for the hot paths of the library. Every benchmark prints
+ * the time per call for safe_print and for the equivalent snprintf/fprintf call as
+ * a reference. Compile with optimizations enabled, e.g. -O2. Add
+ * -DSAFE_PRINT_FORMAT_CACHE_SIZE=64 to measure with the format cache.
+ */
+
+#define ITERATIONS 1000000
+
+static double now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(char const *name, double start, double end, int iterations) {
+    safe_print("{min(44)} {min(10):fill( ):precision(2)} ns/call\n", name, (end - start) * 1e9 / iterations);
+}
+
+static volatile int sink;
+
+
+static void benchmark_literal_runs(FILE *null_device) {
+    char buffer[512];
+    double start;
+    
+    safe_print("Literal runs:\n");
+    
+    start = now();
+    for (int i = 0; i < ITERATIONS; i += 1) {
+        sink += safe_print_buffer(buffer, sizeof(buffer), "[worker] request finished, cache state is fine: {}\n", i);
+    }
+    report("safe_print_buffer, 48 byte prefix", start, now(), ITERATIONS);
+    
+    start = now();
+    for (int i = 0; i < ITERATIONS; i += 1) {
+        sink += snprintf(buffer, sizeof(buffer), "[worker] request finished, cache state is fine: %d\n", i);
+    }
+    report("snprintf, 48 byte prefix", start, now(), ITERATIONS);
+    
+    start = now();
+    for (int i = 0; i < ITERATIONS; i += 1) {
+        sink += safe_print_buffer(buffer, sizeof(buffer), "[2023-01-01 12:00:00] [worker-thread] [info] the request was finished and all connections are closed again, id: {} state: {}\n", i, "done");
+    }
+    report("safe_print_buffer, 120 byte prefix", start, now(), ITERATIONS);
+    
+    start = now();
+    for (int i = 0; i < ITERATIONS; i += 1) {
+        sink += snprintf(buffer, sizeof(buffer), "[2023-01-01 12:00:00] [worker-thread] [info] the request was finished and all connections are closed again, id: %d state: %s\n", i, "done");
+    }
+    report("snprintf, 120 byte prefix", start, now(), ITERATIONS);
+    
+    start = now();
+    for (int i = 0; i < ITERATIONS; i += 1) {
+        sink += safe_print_file(null_device, "[2023-01-01 12:00:00] [worker-thread] [info] the request was finished and all connections are closed again, id: {} state: {}\n", i, "done");
+    }
+    report("safe_print_file, 120 byte prefix", start, now(), ITERATIONS);
+    
+    start = now();
+    for (int i = 0; i < ITERATIONS; i += 1) {
+        sink += fprintf(null_device, "[2023-01-01 12:00:00] [worker-thread] [info] the request was finished and all connections are closed again, id: %d state: %s\n", i, "done");
+    }
+    report("fprintf, 120 byte prefix", start, now(), ITERATIONS);
+    
+    safe_print("\n");
+}
+
+static void benchmark_padding(void) {
+    char buffer[512];
+    double start;
+    
+    safe_print("Padding:\n");
+    
+    start = now();
+    for (int i = 0; i < ITERATIONS; i += 1) {
+        sink += safe_print_buffer(buffer, sizeof(buffer), "|{min(40)}|{min(40):right}|{min(12):fill( )}|\n", "name", "value", i);
+    }
+    report("safe_print_buffer, three padded columns", start, now(), ITERATIONS);
+    
+    start = now();
+    for (int i = 0; i < ITERATIONS; i += 1) {
+        sink += snprintf(buffer, sizeof(buffer), "|%-40s|%40s|%12d|\n", "name", "value", i);
+    }
+    report("snprintf, three padded columns", start, now(), ITERATIONS);
+    
+    safe_print("\n");
+}
+
+static void benchmark_case_conversion(void) {
+    char buffer[512];
+    char const *message = "The connection to the upstream server was closed unexpectedly while reading the response header";
+    double start;
+    
+    safe_print("Case conversion:\n");
+    
+    start = now();
+    for (int i = 0; i < ITERATIONS; i += 1) {
+        sink += safe_print_buffer(buffer, sizeof(buffer), "{upper}\n", message);
+    }
+    report("safe_print_buffer, 96 bytes {upper}", start, now(), ITERATIONS);
+    
+    start = now();
+    for (int i = 0; i < ITERATIONS; i += 1) {
+        sink += safe_print_buffer(buffer, sizeof(buffer), "{}\n", message);
+    }
+    report("safe_print_buffer, 96 bytes unchanged", start, now(), ITERATIONS);
+    
+    safe_print("\n");
+}
+
+static void benchmark_integers(void) {
+    char buffer[512];
+    double start;
+    
+    safe_print("Integers:\n");
+    
+    start = now();
+    for (int i = 0; i < ITERATIONS; i += 1) {
+        sink += safe_print_buffer(buffer, sizeof(buffer), "{} {}", -i * 2039, (unsigned short)i);
+    }
+    report("safe_print_buffer, i32 and u32", start, now(), ITERATIONS);
+    
+    start = now();
+    for (int i = 0; i < ITERATIONS; i += 1) {
+        sink += snprintf(buffer, sizeof(buffer), "%d %u", -i * 2039, (unsigned short)i);
+    }
+    report("snprintf, i32 and u32", start, now(), ITERATIONS);
+    
+    start = now();
+    for (int i = 0; i < ITERATIONS; i += 1) {
+        sink += safe_print_buffer(buffer, sizeof(buffer), "{} {}", (sp_s64)i * -9007199254741LL, (sp_u64)i * 18446744073709ULL);
+    }
+    report("safe_print_buffer, i64 and u64", start, now(), ITERATIONS);
+    
+    start = now();
+    for (int i = 0; i < ITERATIONS; i += 1) {
+        sink += snprintf(buffer, sizeof(buffer), "%lld %llu", (long long)i * -9007199254741LL, (unsigned long long)i * 18446744073709ULL);
+    }
+    report("snprintf, i64 and u64", start, now(), ITERATIONS);
+    
+    start = now();
+    for (int i = 0; i < ITERATIONS; i += 1) {
+        sink += safe_print_buffer(buffer, sizeof(buffer), "{hex} {min(16):hex:upper}", (sp_u64)i * 18446744073709ULL, (sp_u64)i << 20);
+    }
+    report("safe_print_buffer, two hex u64", start, now(), ITERATIONS);
+    
+    start = now();
+    for (int i = 0; i < ITERATIONS; i += 1) {
+        sink += snprintf(buffer, sizeof(buffer), "%llx %016llX", (unsigned long long)i * 18446744073709ULL, (unsigned long long)i << 20);
+    }
+    report("snprintf, two hex u64", start, now(), ITERATIONS);
+    
+    safe_print("\n");
+}
+
+static unsigned long long random_state = 0x9E3779B97F4A7C15ULL;
+
+// NOTE: Random bit patterns cover every exponent, NaN and Inf are skipped.
+static double random_double(void) {
+    for (;;) {
+        random_state ^= random_state << 13;
+        random_state ^= random_state >> 7;
+        random_state ^= random_state << 17;
+        
+        double value;
+        memcpy(&value, &random_state, sizeof(value));
+        if (value == value && value - value == 0) return value;
+    }
+}
+
+static void benchmark_doubles(void) {
+    static double values[4096];
+    char buffer[512];
+    double start;
+    
+    for (int i = 0; i < 4096; i += 1) values[i] = random_double();
+    
+    safe_print("Doubles:\n");
+    
+    start = now();
+    for (int i = 0; i < ITERATIONS; i += 1) {
+        sink += safe_print_buffer(buffer, sizeof(buffer), "{}", values[i & 4095]);
+    }
+    report("safe_print_buffer, shortest {}", start, now(), ITERATIONS);
+    
+    start = now();
+    for (int i = 0; i < ITERATIONS; i += 1) {
+        sink += safe_print_buffer(buffer, sizeof(buffer), "{sci:precision(16)}", values[i & 4095]);
+    }
+    report("safe_print_buffer, {sci:precision(16)}", start, now(), ITERATIONS);
+    
+    start = now();
+    for (int i = 0; i < ITERATIONS; i += 1) {
+        sink += snprintf(buffer, sizeof(buffer), "%.17g", values[i & 4095]);
+    }
+    report("snprintf, 17 digits %.17g", start, now(), ITERATIONS);
+    
+    // NOTE: Every printed double has to read back as exactly the same value.
+    int mismatches = 0;
+    for (int i = 0; i < ITERATIONS; i += 1) {
+        double value = random_double();
+        safe_print_buffer(buffer, sizeof(buffer), "{}", value);
+        
+        double parsed = strtod(buffer, 0);
+        if (memcmp(&parsed, &value, sizeof(value))) {
+            if (mismatches < 10) safe_print("round trip failed: {} read back as {sci:precision(16)}\n", buffer, parsed);
+            mismatches += 1;
+        }
+    }
+    safe_print("{min(44)} {min(10):fill( )} of {}\n", "round trip mismatches", mismatches, ITERATIONS);
+    
+    safe_print("\n");
+}
+
+static float random_float(void) {
+    for (;;) {
+        random_double();
+        
+        unsigned int bits = (unsigned int)(random_state >> 32);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        if (value == value && value - value == 0) return value;
+    }
+}
+
+static void benchmark_floats(void) {
+    static float values[4096];
+    char buffer[512];
+    double start;
+    
+    for (int i = 0; i < 4096; i += 1) values[i] = random_float();
+    
+    safe_print("Floats:\n");
+    
+    start = now();
+    for (int i = 0; i < ITERATIONS; i += 1) {
+        sink += safe_print_buffer(buffer, sizeof(buffer), "{}", values[i & 4095]);
+    }
+    report("safe_print_buffer, shortest float {}", start, now(), ITERATIONS);
+    
+    start = now();
+    for (int i = 0; i < ITERATIONS; i += 1) {
+        sink += safe_print_buffer(buffer, sizeof(buffer), "{}", (double)values[i & 4095]);
+    }
+    report("safe_print_buffer, widened to double {}", start, now(), ITERATIONS);
+    
+    start = now();
+    for (int i = 0; i < ITERATIONS; i += 1) {
+        sink += snprintf(buffer, sizeof(buffer), "%.9g", values[i & 4095]);
+    }
+    report("snprintf, 9 digits %.9g", start, now(), ITERATIONS);
+    
+    // NOTE: Every printed float has to read back as exactly the same value.
+    int mismatches = 0;
+    for (int i = 0; i < 4096; i += 1) {
+        safe_print_buffer(buffer, sizeof(buffer), "{}", values[i]);
+        
+        float parsed = strtof(buffer, 0);
+        if (memcmp(&parsed, &values[i], sizeof(parsed))) {
+            if (mismatches < 10) safe_print("round trip failed: {} read back as {sci:precision(8)}\n", buffer, parsed);
+            mismatches += 1;
+        }
+    }
+    safe_print("{min(44)} {min(10):fill( )} of {}\n", "round trip mismatches", mismatches, 4096);
+    
+    safe_print("\n");
+}
+
+static void benchmark_truncated_strings(void) {
+    static char payload[16 * 1024];
+    char buffer[512];
+    double start;
+    
+    memset(payload, 'x', sizeof(payload) - 1);
+    
+    safe_print("Truncated strings:\n");
+    
+    start = now();
+    for (int i = 0; i < ITERATIONS; i += 1) {
+        sink += safe_print_buffer(buffer, sizeof(buffer), "{max(16)}\n", payload);
+    }
+    report("safe_print_buffer, 16KB string {max(16)}", start, now(), ITERATIONS);
+    
+    start = now();
+    for (int i = 0; i < ITERATIONS; i += 1) {
+        sink += snprintf(buffer, sizeof(buffer), "%.16s\n", payload);
+    }
+    report("snprintf, 16KB string %.16s", start, now(), ITERATIONS);
+    
+    start = now();
+    for (int i = 0; i < ITERATIONS / 100; i += 1) {
+        sink += safe_print_buffer(buffer, sizeof(buffer), "{}\n", payload);
+    }
+    report("safe_print_buffer, 16KB string {}", start, now(), ITERATIONS / 100);
+    
+    safe_print("\n");
+}
+
+static void benchmark_binary_log(FILE *null_device) {
+    static SafePrintBinaryLog log;
+    long long text_bytes = 0;
+    long long binary_bytes = 0;
+    double start;
+    
+    safe_print("Binary log:\n");
+    safe_print_binary_open(&log, null_device);
+    
+    start = now();
+    for (int i = 0; i < ITERATIONS; i += 1) {
+        text_bytes += safe_print_file(null_device, "request {} sent {} bytes, ratio {}, status {hex}\n", i, i * 4099ULL, i * 0.25, 0xc0de);
+    }
+    report("safe_print_file, int/u64/double/hex", start, now(), ITERATIONS);
+    
+    start = now();
+    for (int i = 0; i < ITERATIONS; i += 1) {
+        binary_bytes += safe_print_binary(&log, "request {} sent {} bytes, ratio {}, status {hex}\n", i, i * 4099ULL, i * 0.25, 0xc0de);
+    }
+    report("safe_print_binary, int/u64/double/hex", start, now(), ITERATIONS);
+    
+    safe_print("{min(44)} {min(10):fill( )} bytes/call\n", "text", text_bytes / ITERATIONS);
+    safe_print("{min(44)} {min(10):fill( )} bytes/call\n", "binary", binary_bytes / ITERATIONS);
+    
+    safe_print("\n");
+}
+
+static void benchmark_compiled_format(FILE *null_device) {
+    SafePrintCompiledFormat format = safe_print_compile("{min(16)} {min(8):fill( )} {min(8):hex} {upper}\n");
+    double start;
+    
+    safe_print("Compiled format:\n");
+    
+    start = now();
+    for (int i = 0; i < ITERATIONS; i += 1) {
+        sink += safe_print_file(null_device, "{min(16)} {min(8):fill( )} {min(8):hex} {upper}\n", "worker", i, i * 31, "ok");
+    }
+    report("safe_print_file, parsed every call", start, now(), ITERATIONS);
+    
+    start = now();
+    for (int i = 0; i < ITERATIONS; i += 1) {
+        sink += safe_print_compiled_file(null_device, &format, "worker", i, i * 31, "ok");
+    }
+    report("safe_print_compiled_file, parsed once", start, now(), ITERATIONS);
+    
+#if defined(SAFE_PRINT_FORMAT_CACHE_SIZE)
+    SafePrintFormatCacheStats stats = safe_print_format_cache_stats();
+    safe_print("format cache: {} hits, {} misses\n", stats.hits, stats.misses);
+#endif
+    
+    safe_print("\n");
+}
+
+static void benchmark_levels(FILE *null_device) {
+    double start;
+    
+    safe_print("Log levels:\n");
+    
+    // NOTE: Debug calls are compiled in but filtered at runtime, only the level check is left.
+    safe_print_set_runtime_level(SAFE_PRINT_LEVEL_INFO);
+    
+    start = now();
+    for (int i = 0; i < ITERATIONS; i += 1) {
+        safe_print_debug("request {} took {} ms, status {hex}\n", i, i * 0.25, 0xc0de);
+    }
+    report("safe_print_debug, filtered at runtime", start, now(), ITERATIONS);
+    
+    start = now();
+    for (int i = 0; i < ITERATIONS; i += 1) {
+        safe_print_log(SAFE_PRINT_LEVEL_INFO, null_device, "request {} took {} ms, status {hex}\n", i, i * 0.25, 0xc0de);
+    }
+    report("safe_print_log, enabled", start, now(), ITERATIONS);
+    
+    start = now();
+    for (int i = 0; i < ITERATIONS; i += 1) {
+        sink += safe_print_file(null_device, "request {} took {} ms, status {hex}\n", i, i * 0.25, 0xc0de);
+    }
+    report("safe_print_file", start, now(), ITERATIONS);
+    
+    safe_print_set_runtime_level(SAFE_PRINT_LEVEL_TRACE);
+    
+    safe_print("\n");
+}
+
+
+int main(int argc, char **argv) {
+    FILE *null_device = fopen(NULL_DEVICE, "w");
+    
+    benchmark_literal_runs(null_device);
+    benchmark_padding();
+    benchmark_case_conversion();
+    benchmark_integers();
+    benchmark_doubles();
+    benchmark_floats();
+    benchmark_truncated_strings();
+    benchmark_binary_log(null_device);
+    benchmark_compiled_format(null_device);
+    benchmark_levels(null_device);
+    
+    fclose(null_device);
+}
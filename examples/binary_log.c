@@ -0,0 +1,20 @@
+
+#define SAFE_PRINT_IMPLEMENTATION
+#include "../safe_print.h"
+
+
+// NOTE: Only the format string id, the argument types and the raw values are written.
+//       Use binary_log_decoder to turn log.bin into text again.
+int main(int argc, char **argv) {
+    static SafePrintBinaryLog log;
+    
+    FILE *file = fopen("log.bin", "wb");
+    safe_print_binary_open(&log, file);
+    
+    for (int i = 0; i < 10; i += 1) {
+        safe_print_binary(&log, "request {min(4)} took {precision(3)} ms, status {hex}\n", i, i * 1.25, 0xc0de + i);
+    }
+    safe_print_binary(&log, "{} finished after {} requests\n", argv[0], 10);
+    
+    fclose(file);
+}
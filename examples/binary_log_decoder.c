@@ -0,0 +1,47 @@
+
+#define SAFE_PRINT_IMPLEMENTATION
+#include "../safe_print.h"
+
+#include <stdlib.h>
+
+
+// NOTE: Has to be compiled with the same SAFE_PRINT_BINARY_MAX_FORMATS and on a platform
+//       with the same byte order as the program that wrote the log.
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        safe_print("Usage: {} <binary log>\n", argv[0]);
+        return 1;
+    }
+    
+    FILE *file = fopen(argv[1], "rb");
+    if (!file) {
+        safe_print("Could not open {}\n", argv[1]);
+        return 1;
+    }
+    
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size < 0) {
+        safe_print("Could not get the size of {}\n", argv[1]);
+        fclose(file);
+        return 1;
+    }
+    
+    char *data = malloc((size_t)size + 1);
+    if (!data) {
+        safe_print("Could not allocate {} bytes for {}\n", size, argv[1]);
+        fclose(file);
+        return 1;
+    }
+    size = fread(data, 1, size, file);
+    fclose(file);
+    
+    int records = safe_print_binary_decode(stdout, data, size);
+    free(data);
+    
+    if (records < 0) {
+        safe_print("Error {} while decoding {}\n", records, argv[1]);
+        return 1;
+    }
+}
@@ -17,14 +17,6 @@ typedef PlatformFile SafePrintFileType;
 #define print safe_print
 
 
-static void safe_print_output_character(SafePrintContext *context, char c) {
-    if (fputc(c, context->file.handle) == EOF) {
-        context->error = sp_true;
-    } else {
-        context->written += 1;
-    }
-}
-
 static void safe_print_output_string(SafePrintContext *context, char const *str, size_t length) {
     size_t written = fwrite(str, 1, length, context->file.handle);
     context->written += written;
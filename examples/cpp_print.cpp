@@ -0,0 +1,27 @@
+
+#define SAFE_PRINT_IMPLEMENTATION
+#include "../safe_print.h"
+
+#include <string>
+#include <string_view>
+
+
+int main(int argc, char **argv) {
+    // NOTE: The format string is checked by the compiler, a wrong specifier or a missing argument doesn't compile.
+    safe_print::print<"Hello {}!\n">("World");
+    safe_print::print<"{min(10):left}|{min(8):hex:upper}|{precision(2)}\n">("flags", 48879, 3.14159);
+    
+    // NOTE: Positional arguments work the same way as with safe_print.
+    safe_print::print<"{2} before {1}\n">("first", "second");
+    
+    char buffer[32];
+    int length = safe_print::print_buffer<"{} + {} = {}">(buffer, sizeof(buffer), 1, 2, 3);
+    safe_print::print_file<"Formatted {} characters: {}\n">(stdout, length, buffer);
+    
+    // NOTE: Strings with a size are printed without looking for the terminating 0.
+    std::string_view path = "/usr/local/include";
+    safe_print::print<"{} in {}\n">(path.substr(11), std::string("/usr/local"));
+    
+    // safe_print::print<"{} and {}\n">(1);        // error: not enough arguments
+    // safe_print::print<"{min(8):hexx}\n">(1);    // error: unknown format specifier
+}
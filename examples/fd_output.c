@@ -0,0 +1,20 @@
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// NOTE: Only available on POSIX systems. The file type becomes a plain file descriptor.
+#define SAFE_PRINT_USE_FD_OUTPUT
+
+#define SAFE_PRINT_IMPLEMENTATION
+#include "../safe_print.h"
+#define print safe_print
+
+
+int main(int argc, char **argv) {
+    // NOTE: Every call ends up in a single writev as long as it fits into the staging buffer.
+    print("Application name: {}, arg count: {}\n", argv[0], argc);
+    
+    int fd = open("log.txt", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    safe_print_file(fd, "The answer is: {}\n", 42);
+    close(fd);
+}
@@ -0,0 +1,27 @@
+
+#define SAFE_PRINT_FLIGHT_RECORDER
+#define SAFE_PRINT_IMPLEMENTATION
+#include "../safe_print.h"
+
+#include <stdlib.h>
+
+
+// NOTE: Writes far more records than fit into the ring and crashes on purpose at the end.
+//       flight_recorder_dump prints the last ones from flight.rec afterwards.
+int main(int argc, char **argv) {
+    static SafePrintFlightRecorder recorder;
+    
+    if (!safe_print_recorder_open(&recorder, "flight.rec", 64 * 1024)) {
+        safe_print("Could not open flight.rec\n");
+        return 1;
+    }
+    
+    for (int i = 0; i < 100000; i += 1) {
+        safe_print_recorder(&recorder, "request {min(6)} took {precision(3)} ms, status {hex}\n", i, i * 0.125, 0xc0de + i % 16);
+    }
+    safe_print_recorder(&recorder, "{} is about to crash\n", argv[0]);
+    
+    // NOTE: Nothing has to be flushed or closed, the records are in the mapping as soon as
+    //       safe_print_recorder returns.
+    abort();
+}
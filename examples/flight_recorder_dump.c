@@ -0,0 +1,47 @@
+
+#define SAFE_PRINT_FLIGHT_RECORDER
+#define SAFE_PRINT_IMPLEMENTATION
+#include "../safe_print.h"
+
+#include <stdlib.h>
+
+
+// NOTE: Has to be compiled for a platform with the same byte order as the program that wrote the records.
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        safe_print("Usage: {} <flight recorder file>\n", argv[0]);
+        return 1;
+    }
+    
+    FILE *file = fopen(argv[1], "rb");
+    if (!file) {
+        safe_print("Could not open {}\n", argv[1]);
+        return 1;
+    }
+    
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size < 0) {
+        safe_print("Could not get the size of {}\n", argv[1]);
+        fclose(file);
+        return 1;
+    }
+    
+    char *data = malloc((size_t)size + 1);
+    if (!data) {
+        safe_print("Could not allocate {} bytes for {}\n", size, argv[1]);
+        fclose(file);
+        return 1;
+    }
+    size = fread(data, 1, size, file);
+    fclose(file);
+    
+    int records = safe_print_recorder_dump(stdout, data, size);
+    free(data);
+    
+    if (records < 0) {
+        safe_print("Error {} while reading {}\n", records, argv[1]);
+        return 1;
+    }
+}
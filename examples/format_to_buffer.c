@@ -0,0 +1,25 @@
+
+#define SAFE_PRINT_IMPLEMENTATION
+// NOTE: Define this for printing a useful message on error
+// #define SAFE_PRINT_DEBUG
+
+#include "../safe_print.h"
+
+
+int main(int argc, char **argv) {
+    char buffer[32];
+    
+    int length = safe_print_buffer(buffer, sizeof(buffer), "{} + {} = {}", 1, 2, 3);
+    safe_print("Formatted {} characters: {}\n", length, buffer);
+    
+    length = safe_print_buffer(buffer, sizeof(buffer), "Application name: {}", argv[0]);
+    safe_print("Truncated to {} of {} characters: {}\n", (int)sizeof(buffer) - 1, length, buffer);
+    
+    // NOTE: Like snprintf you can ask for the needed size first.
+    length = safe_print_buffer(0, 0, "{min(40):fill(.)}", "right aligned");
+    safe_print("Needed size: {}\n", length + 1);
+    
+    // NOTE: Parts of a buffer can be printed without a terminating 0.
+    char const *request = "GET /index.html HTTP/1.1";
+    safe_print("Method: {}, path: {min(12):left}|\n", sp_str(request, 3), sp_str(request + 4, 11));
+}
@@ -0,0 +1,34 @@
+#define SAFE_PRINT_IMPLEMENTATION
+// NOTE: Define this for printing a useful message on error
+// #define SAFE_PRINT_DEBUG
+
+#include "../safe_print.h"
+
+
+static FILE *log_file;
+static char last_error[128];
+
+// NOTE: The arguments are converted once and then printed to stdout, the log file and a buffer.
+static void log_error_args(char const *fmt, SafePrintArgs args) {
+    safe_print("ERROR: ");
+    safe_vprint(fmt, args);
+    
+    safe_print_file(log_file, "ERROR: ");
+    safe_vprint_file(log_file, fmt, args);
+    
+    safe_vprint_buffer(last_error, sizeof(last_error), fmt, args);
+}
+
+#define log_error(fmt, ...) log_error_args((fmt), safe_print_args(__VA_ARGS__))
+
+
+int main(int argc, char **argv) {
+    log_file = fopen("log.txt", "w");
+    
+    log_error("{} is not the answer to everything.\n", 41);
+    log_error("Could not open {}, {min(4):fill( )} attempts left.\n", "config.ini", 3);
+    
+    safe_print("Last error: {}", last_error);
+    
+    fclose(log_file);
+}
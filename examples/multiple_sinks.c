@@ -0,0 +1,46 @@
+
+#define SAFE_PRINT_IMPLEMENTATION
+#include "../safe_print.h"
+
+
+typedef struct LineCounter {
+    int lines;
+    size_t bytes;
+} LineCounter;
+
+// NOTE: A custom sink, this is where a record could be handed to a network forwarder.
+static int count_lines(void *user, char const *data, size_t length) {
+    LineCounter *counter = (LineCounter*)user;
+    
+    for (size_t i = 0; i < length; i += 1) {
+        if (data[i] == '\n') counter->lines += 1;
+    }
+    counter->bytes += length;
+    
+    return 0;
+}
+
+
+int main(int argc, char **argv) {
+    FILE *file = fopen("multiple_sinks.txt", "w");
+    if (!file) {
+        safe_print("Could not open multiple_sinks.txt\n");
+        return 1;
+    }
+    
+    LineCounter counter = {0};
+    SafePrintSink sinks[] = {
+        { stdout, 0, 0 },
+        { file, 0, 0 },
+        { 0, count_lines, &counter },
+    };
+    
+    // NOTE: The format string is parsed and the arguments are converted once for all sinks.
+    for (int i = 0; i < 3; i += 1) {
+        safe_print_sinks(sinks, 3, "request {min(4)} took {precision(3)} ms, status {hex}\n", i, i * 1.25, 0xc0de + i);
+    }
+    
+    fclose(file);
+    
+    safe_print("The counting sink got {} lines and {} bytes\n", counter.lines, counter.bytes);
+}
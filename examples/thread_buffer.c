@@ -0,0 +1,99 @@
+
+#define SAFE_PRINT_THREAD_BUFFER_SIZE 16384
+#define SAFE_PRINT_IMPLEMENTATION
+#include "../safe_print.h"
+
+#include <threads.h>
+#include <time.h>
+
+#if defined(_WIN32) || defined(WIN32)
+#define NULL_DEVICE "NUL"
+#else
+#define NULL_DEVICE "/dev/null"
+#endif
+
+
+/*
+ * Every thread collects what it prints in a buffer per file and writes it in one piece.
+ * The workers never flush, their buffers are written when they exit. The timing prints
+ * small records alternately to two unbuffered files, once collected until the buffers
+ * are full and once written at the end of every line, which is what every record costs
+ * without the thread buffer.
+ */
+
+#define WORKERS 3
+#define RECORDS 200000
+
+static double now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int worker(void *data) {
+    int id = (int)(intptr_t)data;
+    
+    // NOTE: Nothing is written before the thread exits, the lines of a worker stay together.
+    for (int i = 0; i < 3; i += 1) {
+        safe_print("worker {} line {}\n", id, i);
+    }
+    
+    return 0;
+}
+
+static double time_records(FILE *log_file, FILE *audit_file, int policy) {
+    safe_print_flush_policy(policy);
+    
+    double start = now();
+    for (int i = 0; i < RECORDS; i += 2) {
+        safe_print_file(log_file, "request {} took {} ms\n", i, i % 97);
+        safe_print_file(audit_file, "request {} by user {}\n", i + 1, i % 13);
+    }
+    int failed = safe_print_flush();
+    double end = now();
+    
+    if (failed) safe_print("A write failed.\n");
+    safe_print_flush_policy(SAFE_PRINT_FLUSH_FULL);
+    
+    return (end - start) * 1e9 / RECORDS;
+}
+
+
+int main(int argc, char **argv) {
+    thrd_t threads[WORKERS];
+    for (int i = 0; i < WORKERS; i += 1) {
+        thrd_create(&threads[i], worker, (void*)(intptr_t)i);
+    }
+    for (int i = 0; i < WORKERS; i += 1) {
+        thrd_join(threads[i], 0);
+    }
+    
+    // NOTE: The buffer of the main thread has to be written before the timing starts, so
+    //       it doesn't end up between the lines of the workers.
+    safe_print("Workers are done.\n");
+    safe_print_flush();
+    
+    // NOTE: Without a stdio buffer every write of the thread buffer is one write to the system.
+    FILE *log_file = fopen(NULL_DEVICE, "w");
+    FILE *audit_file = fopen(NULL_DEVICE, "w");
+    if (!log_file || !audit_file) {
+        safe_print("Could not open {}\n", NULL_DEVICE);
+        return 1;
+    }
+    setvbuf(log_file, 0, _IONBF, 0);
+    setvbuf(audit_file, 0, _IONBF, 0);
+    
+    double full = time_records(log_file, audit_file, SAFE_PRINT_FLUSH_FULL);
+    double line = time_records(log_file, audit_file, SAFE_PRINT_FLUSH_LINE);
+    
+    // NOTE: Both buffers were written by safe_print_flush in time_records, so closing is safe.
+    fclose(log_file);
+    fclose(audit_file);
+    
+    safe_print("{min(24)} {min(10):fill( ):precision(2)} ns/record\n", "SAFE_PRINT_FLUSH_FULL", full);
+    safe_print("{min(24)} {min(10):fill( ):precision(2)} ns/record\n", "SAFE_PRINT_FLUSH_LINE", line);
+    
+    // NOTE: Not flushed on purpose, the buffer of the main thread is written at exit.
+    safe_print("Done.\n");
+}
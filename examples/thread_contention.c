@@ -0,0 +1,112 @@
+
+#define SAFE_PRINT_IMPLEMENTATION
+#include "../safe_print.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <time.h>
+
+
+/*
+ * Several threads print records of different lengths to the same FILE*. Afterwards the
+ * file is read back and every line that is not exactly one record is counted as torn.
+ * Build it once as is and once with -DSAFE_PRINT_ATOMIC_RECORDS to compare both modes.
+ * Records longer than the staging buffer (SAFE_PRINT_BUFFER_SIZE) need several fwrites
+ * and are the ones that get split without the lock.
+ */
+
+#define THREADS 4
+#define RECORDS 100000
+
+static FILE *shared_file;
+static char payloads[THREADS][1500];
+
+static double now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// NOTE: Every record is "<thread> <length> " followed by length copies of the thread's letter.
+static int record_length(int thread, int record) {
+    return (thread * 977 + record * 131) % 1500;
+}
+
+static int worker(void *data) {
+    int thread = (int)(intptr_t)data;
+    
+    for (int i = 0; i < RECORDS; i += 1) {
+        int length = record_length(thread, i);
+        safe_print_file(shared_file, "{} {} {}\n", thread, length, sp_str(payloads[thread], length));
+    }
+    
+    return 0;
+}
+
+static int count_torn_lines(FILE *file, int *lines) {
+    static char line[4096];
+    int torn = 0;
+    
+    *lines = 0;
+    rewind(file);
+    while (fgets(line, sizeof(line), file)) {
+        *lines += 1;
+        
+        int thread = line[0] - '0';
+        char *end = 0;
+        long length = strtol(line + 2, &end, 10);
+        if (thread < 0 || thread >= THREADS || line[1] != ' ' || *end != ' ') {
+            torn += 1;
+            continue;
+        }
+        
+        char *letters = end + 1;
+        int intact = (long)strlen(letters) == length + 1;
+        for (long i = 0; intact && i < length; i += 1) {
+            intact = letters[i] == 'a' + thread;
+        }
+        torn += !intact;
+    }
+    
+    return torn;
+}
+
+
+int main(int argc, char **argv) {
+    for (int i = 0; i < THREADS; i += 1) {
+        memset(payloads[i], 'a' + i, sizeof(payloads[i]));
+    }
+    
+    shared_file = tmpfile();
+    if (!shared_file) {
+        safe_print("Could not create a temporary file.\n");
+        return 1;
+    }
+    
+#if defined(SAFE_PRINT_ATOMIC_RECORDS)
+    safe_print("Mode: SAFE_PRINT_ATOMIC_RECORDS\n");
+#else
+    safe_print("Mode: default\n");
+#endif
+    
+    thrd_t threads[THREADS];
+    double start = now();
+    for (int i = 0; i < THREADS; i += 1) {
+        thrd_create(&threads[i], worker, (void*)(intptr_t)i);
+    }
+    for (int i = 0; i < THREADS; i += 1) {
+        thrd_join(threads[i], 0);
+    }
+    double end = now();
+    
+    int lines;
+    int torn = count_torn_lines(shared_file, &lines);
+    
+    safe_print("{min(24)} {min(10):fill( ):precision(2)} ns/record\n", "time", (end - start) * 1e9 / (THREADS * RECORDS));
+    safe_print("{min(24)} {min(10):fill( )}\n", "lines", lines);
+    safe_print("{min(24)} {min(10):fill( )}\n", "torn lines", torn);
+    
+    fclose(shared_file);
+}
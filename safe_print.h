@@ -53,7 +53,7 @@
  * support all specifiers. (see size_t and %zu)
  * The function uses a python like syntax with {} as a placeholder for
  * the replacement. But the syntax is different.
- * The library currently only supports 16 arguments to the print routine.
+ * The library currently supports up to 32 arguments to the print routine.
  *
  * ----------------------------------------------------------------------------
  *
@@ -77,12 +77,19 @@
  *
  * This will print "The answer is: 42" to the file log.txt.
  *
+ * char buffer[64];
+ * int length = safe_print_buffer(buffer, sizeof(buffer), "{} + {} = {}", 1, 2, 3);
+ *
+ * This will format "1 + 2 = 3" into the buffer without involving any file API.
+ * Like snprintf the output is truncated to fit and always terminated with a 0.
+ * The return value is the length the full output would have needed.
+ *
  * You can find some more use cases in the examples folder.
  *
  * Format specifiers:
- * - 1 to 16:            number of the argument to be printed.
+ * - 1 to 32:            number of the argument to be printed.
  * - min(number):        the minimum width of the printed argument
- * - max(number):        the maximum width of the printed argument
+ * - max(number):        the maximum width of the printed argument (a string is not read past it)
  * - left:               align printing on the left of the minimum space
  * - right:              align printing on the right of the minimum space
  * - fill(character):    the fill character for the minimum space (default: 0 for numbers, ' ' for text)
@@ -90,6 +97,7 @@
  * - base(number):       the base of the number to print
  * - bin, oct, dec, hex: short for base of 2, 8, 10, 16 respectivly (hex used for hex-float as well)
  * - sci:                scientific notation for floats
+ * - short:              the fewest digits that read back as the same float (the default without a precision)
  * - sign:               always print the sign with a number
  * - upper:              upper case for hex characters and printing strings in uppercase
  * - lower:              lower case for hex characters and printing strings in lowercase
@@ -98,24 +106,115 @@
  * If the specifier is not useful for the argument it will be ignored, repeating
  * specifiers will be overridden.
  *
+ * Floats without a precision are printed with the fewest digits that read back as the
+ * same value, in fixed notation from 1e-6 up to 1e21 and in scientific notation otherwise
+ * (e.g. 0.1, 42, 1.5e+21).
+ * A float argument is shortened as a float, so 0.1f prints as 0.1 and not as the double it widens to.
+ *
  * On error the function returns a negative integer describing the error.
  * On success the written characters.
  *
+ * Forwarding arguments:
+ *
+ * #define log_error(fmt, ...) log_error_args((fmt), safe_print_args(__VA_ARGS__))
+ *
+ * void log_error_args(char const *fmt, SafePrintArgs args) {
+ *     safe_print_file(log_file, "ERROR: ");
+ *     safe_vprint_file(log_file, fmt, args);
+ * }
+ *
+ * Like vprintf, safe_vprint, safe_vprint_file and safe_vprint_buffer take arguments
+ * that were captured by another call. safe_print_args converts them once, the handle
+ * can then be passed on and printed as often as needed. It stays valid until the end
+ * of the block that called safe_print_args.
+ *
+ * Sized strings:
+ *
+ * safe_print("{}: {}\n", sp_str(name, name_length), sp_str(line + 4, 12));
+ *
+ * sp_str wraps a pointer and a length into a SafePrintStringRef, which is printed
+ * like a string without looking for its terminating 0. Slices of a larger buffer can be
+ * printed without copying them first. In C++ std::string and std::string_view
+ * arguments are passed the same way.
+ *
+ * Compiled formats:
+ *
+ * SafePrintCompiledFormat format = safe_print_compile("{min(8)} | {hex}\n");
+ * safe_print_compiled(&format, name, flags);
+ *
+ * A format string used in a hot loop can be parsed once up front. The compiled format
+ * keeps the literal text as pointers into the format string, so the string has to stay
+ * valid as long as the compiled format is used. Errors in the format string are
+ * reported by safe_print_compile and returned again by every print with it. A format
+ * can have up to SAFE_PRINT_MAX_FORMAT_OPS (default: 32) literal runs and arguments.
+ *
+ * C++:
+ *
+ * safe_print::print<"{min(8)} | {hex}\n">(name, flags);
+ * safe_print::print_file<"{}\n">(file, value);
+ * safe_print::print_buffer<"{} + {} = {}">(buffer, sizeof(buffer), 1, 2, 3);
+ *
+ * With C++20 the header offers templates that take the format string as a template
+ * argument. It is parsed by the compiler, so an unknown specifier, a bad argument index
+ * or a missing argument is a compile error. The output is the same as with safe_print,
+ * only the parsing and the type lookup at runtime are gone. The implementation itself
+ * compiles as C or C++.
+ *
+ * Binary logs:
+ *
+ * static SafePrintBinaryLog log;
+ * safe_print_binary_open(&log, file);
+ * safe_print_binary(&log, "Request {} took {} ms\n", id, ms);
+ *
+ * Instead of the formatted text a compact record with the id of the format string,
+ * the argument types and their raw values is written. The format string itself is
+ * written once per log, the first time it is used. safe_print_binary_decode formats
+ * such a log into text later, see examples/binary_log_decoder.c. A log can hold up to
+ * SAFE_PRINT_BINARY_MAX_FORMATS (default: 256) distinct format strings with
+ * SAFE_PRINT_BINARY_FORMAT_SPACE (default: 16384) bytes in total, it is not thread safe
+ * and it uses the native byte order. Formats are told apart by their text, so a reused
+ * format buffer is fine. A record with more or fewer arguments than its format uses makes
+ * safe_print_binary_decode return SP_ERROR_ARGUMENT_COUNT_MISMATCH.
+ *
+ * Several outputs at once:
+ *
+ * SafePrintSink sinks[] = { { stdout, 0, 0 }, { log_file, 0, 0 }, { 0, forward, &connection } };
+ * safe_print_sinks(sinks, 3, "Request {} took {} ms\n", id, ms);
+ *
+ * The format string is parsed and the arguments are converted once, every sink gets the
+ * same bytes in order. A sink with a write callback gets them together with its user
+ * pointer, any other sink goes to its file. The call returns the length of the output
+ * once, not per sink. A callback returns 0 when it took the data. A sink that fails gets
+ * nothing more of that call while the others still get all of it, the call returns 1 in
+ * the end like a failed write of safe_print_file. A call takes up to SAFE_PRINT_MAX_SINKS
+ * (64) sinks, more return SP_ERROR_TOO_MANY_SINKS. The files are not locked by
+ * SAFE_PRINT_ATOMIC_RECORDS.
+ *
+ * Log levels:
+ *
+ * safe_print_debug("Cache miss for {}\n", key);
+ * safe_print_log(SAFE_PRINT_LEVEL_ERROR, stderr, "Request {} failed\n", id);
+ *
+ * safe_print_trace, safe_print_debug, safe_print_info, safe_print_warn and safe_print_error
+ * print to stdout, safe_print_log takes the level and the file. Calls below
+ * SAFE_PRINT_MIN_LEVEL (#define it before including the header, default:
+ * SAFE_PRINT_LEVEL_TRACE) are removed by the preprocessor. The others check
+ * safe_print_runtime_level first and only then evaluate and convert their arguments,
+ * a filtered call costs a single branch. They are statements and return nothing. Change
+ * the level with safe_print_set_runtime_level(), which is safe while other threads print.
+ *
  * ----------------------------------------------------------------------------
  *
  * How it works:
  *
- * The library has defined an index for ever supported type.
- * C11's _Generic macro maps the specified type to the appropriate index
- * (starting at 1) and a macro puts a pair of {index, argument} behind the
- * format string of the function.
- * As the function itself is a C99 variadic macro and there are 16 versions
+ * The library has defined a small constructor for every supported type.
+ * C11's _Generic macro picks the constructor for the specified type, which
+ * stores the argument together with its kind in a SafePrintFormatArg.
+ * As the function itself is a C99 variadic macro and there are 32 versions
  * defined to make it recursive. This number can easily be bumped up.
- * After converting every passed argument to a pair a 0 is added to mark the
- * last argument. The variadic function safe_print_implementation is then
- * scanning all pairs until it reaches 0 and builds an array out of all
- * provided arguments. This makes it possible to use positional specifiers as
- * well.
+ * All converted arguments end up in a compound literal array at the call site
+ * and safe_print_implementation gets a pointer to it and the number of
+ * arguments. This makes it possible to use positional specifiers as well.
  *
  * ----------------------------------------------------------------------------
  *
@@ -130,9 +229,109 @@
  * #define SAFE_PRINT_USE_OWN_FILE_OUTPUT
  * typedef YOUR_OWN_FILE_TYPE SafePrintFileTyp;
  * #define SafePrintStdOut YOU_OWN_STANDARD_OUT
- * static void safe_print_output_character(SafePrintContext *context, char c);
  * static void safe_print_output_string(SafePrintContext *context, char const *str, size_t length);
  *
+ * All output of a call is collected in a staging buffer inside the SafePrintContext
+ * and handed to safe_print_output_string when the buffer is full and once at the end.
+ *
+ *
+ * Write to plain file descriptors with write and writev (POSIX only):
+ *
+ * #define SAFE_PRINT_USE_FD_OUTPUT
+ *
+ * SafePrintFileType becomes an int and SafePrintStdOut is 1. Literal runs and string
+ * arguments of at least SAFE_PRINT_MIN_REFERENCE_SIZE (default: 64) bytes are written
+ * from their place, everything else goes through the staging buffer. All pieces of a
+ * call are sent with a single writev, as long as they fit into the staging buffer and
+ * SAFE_PRINT_MAX_SEGMENTS (default: 32) iovecs.
+ *
+ *
+ * Collect the output of every thread in a buffer of its own (needs C11 threads.h):
+ *
+ * #define SAFE_PRINT_THREAD_BUFFER_SIZE 16384
+ *
+ * Everything a thread prints to a file is collected in a thread local buffer of that size
+ * and handed to the output in one piece, so many small records share a single write. A
+ * thread buffers up to SAFE_PRINT_THREAD_BUFFER_FILES (default: 4) files at once, each
+ * with a buffer of its own. The buffer of a file is written when the next output does not
+ * fit anymore (SAFE_PRINT_FLUSH_FULL, the default) or at the end of every line
+ * (SAFE_PRINT_FLUSH_LINE, set per thread with safe_print_flush_policy), when a further
+ * file needs its place, when the thread calls safe_print_flush() and when it exits. The
+ * output of a thread keeps its order within each file, output to different files and of
+ * different threads only comes in the order of their writes. Buffered bytes can only fail
+ * once they are written, so a failed write is reported by the call that wrote the buffer,
+ * which can come after the call that produced the bytes. If the buffer was written to make
+ * room for another file, safe_print_flush() reports it. With SAFE_PRINT_USE_FD_OUTPUT
+ * everything is copied into the buffer instead of being written from its place. Call
+ * safe_print_flush() before closing a file the thread printed to, see
+ * examples/thread_buffer.c.
+ *
+ *
+ * Keep the last records in a memory mapped ring that survives a crash (POSIX and C11 stdatomic.h):
+ *
+ * #define SAFE_PRINT_FLIGHT_RECORDER
+ *
+ * static SafePrintFlightRecorder recorder;
+ * safe_print_recorder_open(&recorder, "app.rec", 1 << 20);
+ * safe_print_recorder(&recorder, "Request {} took {} ms\n", id, ms);
+ *
+ * The records are formatted and copied into a ring buffer in a file mapped with MAP_SHARED,
+ * a path in /dev/shm keeps it in shared memory. Once safe_print_recorder returned the record
+ * is in the file even if the process dies right after, only the oldest records are
+ * overwritten when the ring is full. Writers only need an atomic fetch-add to reserve
+ * their space, so many threads can share a recorder. safe_print_recorder_attach uses a
+ * region you mapped yourself instead. safe_print_recorder_dump prints the records that are
+ * still in a region oldest first, see examples/flight_recorder_dump.c. A record is cut off
+ * after SAFE_PRINT_RECORDER_MAX_RECORD (default: 1024) bytes. If opening failed,
+ * safe_print_recorder returns SP_ERROR_RECORDER_NOT_OPEN instead of writing anything.
+ *
+ *
+ * Keep the output of a call together when several threads print to the same FILE*:
+ *
+ * #define SAFE_PRINT_ATOMIC_RECORDS
+ *
+ * The stdio lock of the file is taken once for the whole call (flockfile, _lock_file on
+ * Windows), so a record that is larger than the staging buffer and needs several
+ * fwrites is never split by another thread. It has no effect with SAFE_PRINT_USE_FD_OUTPUT
+ * or SAFE_PRINT_USE_OWN_FILE_OUTPUT.
+ *
+ *
+ * Format and print on a background thread (needs C11 threads.h and stdatomic.h):
+ *
+ * #define SAFE_PRINT_ASYNC
+ *
+ * safe_print_async_start(SAFE_PRINT_ASYNC_BLOCK);
+ * safe_print_async("Request {} took {} ms\n", id, ms);
+ * safe_print_async_stop();
+ *
+ * The caller only copies the arguments into a lock free queue, string arguments are
+ * copied as well. The format string itself is not copied and has to stay valid until
+ * it is printed, so use string literals. When the queue is full the caller waits
+ * (SAFE_PRINT_ASYNC_BLOCK) or the record is dropped (SAFE_PRINT_ASYNC_DROP) and
+ * counted (SAFE_PRINT_ASYNC_COUNT_DROPS, see safe_print_async_dropped()).
+ * safe_print_async_stop() prints everything that is left and joins the thread.
+ * Calls before safe_print_async_start() or after safe_print_async_stop() print right
+ * away on the calling thread. An idle background thread sleeps until the next record.
+ * The queue has SAFE_PRINT_ASYNC_QUEUE_SIZE (default: 1024) slots with
+ * SAFE_PRINT_ASYNC_STRING_SPACE (default: 256) bytes for strings each. Longer strings
+ * are truncated. A slot holds up to SAFE_PRINT_ASYNC_MAX_ARGS (default: 16) arguments.
+ *
+ *
+ * Change the size of the staging buffer (default: 512):
+ *
+ * #define SAFE_PRINT_BUFFER_SIZE 4096
+ *
+ *
+ * Cache the parsed format strings per thread, keyed by their address (power of 2):
+ *
+ * #define SAFE_PRINT_FORMAT_CACHE_SIZE 64
+ *
+ * safe_print, safe_print_file and safe_print_buffer then parse a format string only the
+ * first time a thread uses it. Every slot holds a SafePrintCompiledFormat, so the cache
+ * takes about 1.5KB per slot and thread. Only enable it if format strings are literals
+ * or otherwise never change their content while their address is in use.
+ * safe_print_format_cache_stats returns the hits and misses of the calling thread.
+ *
  *
  * Use your own integer conversion:
  *
@@ -146,18 +345,23 @@
  * #define SAFE_PRINT_USE_OWN_FLOAT_CONVERSION
  * static SafePrintStringRef safe_print_convert_double_to_string(char *buffer, sp_s32 size, sp_r64 number, sp_s32 precision, sp_b32 scientific, sp_b32 hex, sp_b32 uppercase, sp_b32 keep_sign);
  *
+ * Without a precision in the format it gets a precision of 6. Float arguments are passed to it as doubles.
+ *
  *
  * Make the function print a descriptive error message:
  *
  * #define SAFE_PRINT_DEBUG
  *
  *
+ * Disable the SSE2/AVX2 code paths (they are picked up from the compiler flags):
+ *
+ * #define SAFE_PRINT_NO_SIMD
+ *
+ *
  * ----------------------------------------------------------------------------
  *
  * Todo:
  *
- * - implement a vprintf like mechanism to forward args to other functions
- * - make a seperate file for formatting into strings as well
  * - shorter format specifiers, maybe > and < for min and max, etc...
  * - the error codes are not correct or not appropriate sometimes
  * - refactor some of the code to make it more readable and shorter
@@ -167,125 +371,32 @@
  * ***************************************************************************/
 
 
+#if !defined(SAFE_PRINT_H)
+#define SAFE_PRINT_H
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 
-#if !defined(SAFE_PRINT_USE_OWN_FILE_OUTPUT)
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(SAFE_PRINT_USE_FD_OUTPUT)
+typedef int SafePrintFileType;
+#define SafePrintStdOut 1
+#elif !defined(SAFE_PRINT_USE_OWN_FILE_OUTPUT)
 #include <stdio.h>
 
 typedef FILE* SafePrintFileType;
 #define SafePrintStdOut stdout
 #endif
 
-int safe_print_implementation(SafePrintFileType handle, char const *fmt, ...);
-
-
-enum {
-    SP_ERROR_TOO_MANY_ARGUMENTS          = -1,
-    SP_ERROR_POSITIONAL_ARG_OUT_OF_RANGE = -2,
-    SP_ERROR_UNKNOWN_FORMAT_SPECIFIER    = -3,
-    SP_ERROR_MISSING_BRACE               = -4,
-};
-
-enum {
-    SAFE_PRINT_CHAR = 1,
-    SAFE_PRINT_UCHAR,
-    SAFE_PRINT_SHORT,
-    SAFE_PRINT_USHORT,
-    SAFE_PRINT_INT,
-    SAFE_PRINT_UINT,
-    SAFE_PRINT_LONG,
-    SAFE_PRINT_ULONG,
-    SAFE_PRINT_LONGLONG,
-    SAFE_PRINT_ULONGLONG,
-    SAFE_PRINT_FLOAT,
-    SAFE_PRINT_DOUBLE,
-    SAFE_PRINT_CHAR_PTR,
-    SAFE_PRINT_VOID_PTR
-};
-
-/*
- * A generic macro to simply get the needed type info for the variadic function.
- * This step would not be necessary if int types where consistent.
- * But long is either 32 or 64 bit depending on the Platform. So we need this for conversion.
- */
-#define SAFE_PRINT_ARG_INDEX(type) _Generic((type),	\
-char:			SAFE_PRINT_CHAR,	\
-unsigned char:		SAFE_PRINT_UCHAR,	\
-short:			SAFE_PRINT_SHORT,	\
-unsigned short:		SAFE_PRINT_USHORT,	\
-int:			SAFE_PRINT_INT,		\
-unsigned int:		SAFE_PRINT_INT,		\
-long:			SAFE_PRINT_LONG,	\
-unsigned long:		SAFE_PRINT_ULONG,	\
-long long:		SAFE_PRINT_LONGLONG,	\
-unsigned long long:	SAFE_PRINT_ULONGLONG,	\
-float:			SAFE_PRINT_FLOAT,	\
-double:			SAFE_PRINT_DOUBLE,	\
-char const*:		SAFE_PRINT_CHAR_PTR,	\
-char*:			SAFE_PRINT_CHAR_PTR,	\
-void const*:		SAFE_PRINT_VOID_PTR,	\
-void*:			SAFE_PRINT_VOID_PTR	\
-)
-
-/*
- * As the variadic macro mechanism of C is of quite limited use, as you can't do any recursion,
- * we have to specify the number of recursions beforehand.
- * If 16 arguments are not enough you need to make this list longer and append to the VA_NUM macro.
- *
- * IMPORTANT: Don't forget to also increase the size of the array in the SafePrintContext!
- */
-#define SAFE_PRINT_ARG_0()
-#define SAFE_PRINT_ARG_1(expr)       SAFE_PRINT_ARG_INDEX(expr), (expr),
-#define SAFE_PRINT_ARG_2(expr, ...)  SAFE_PRINT_ARG_INDEX(expr), (expr), SAFE_PRINT_ARG_1(__VA_ARGS__)
-#define SAFE_PRINT_ARG_3(expr, ...)  SAFE_PRINT_ARG_INDEX(expr), (expr), SAFE_PRINT_ARG_2(__VA_ARGS__)
-#define SAFE_PRINT_ARG_4(expr, ...)  SAFE_PRINT_ARG_INDEX(expr), (expr), SAFE_PRINT_ARG_3(__VA_ARGS__)
-#define SAFE_PRINT_ARG_5(expr, ...)  SAFE_PRINT_ARG_INDEX(expr), (expr), SAFE_PRINT_ARG_4(__VA_ARGS__)
-#define SAFE_PRINT_ARG_6(expr, ...)  SAFE_PRINT_ARG_INDEX(expr), (expr), SAFE_PRINT_ARG_5(__VA_ARGS__)
-#define SAFE_PRINT_ARG_7(expr, ...)  SAFE_PRINT_ARG_INDEX(expr), (expr), SAFE_PRINT_ARG_6(__VA_ARGS__)
-#define SAFE_PRINT_ARG_8(expr, ...)  SAFE_PRINT_ARG_INDEX(expr), (expr), SAFE_PRINT_ARG_7(__VA_ARGS__)
-#define SAFE_PRINT_ARG_9(expr, ...)  SAFE_PRINT_ARG_INDEX(expr), (expr), SAFE_PRINT_ARG_8(__VA_ARGS__)
-#define SAFE_PRINT_ARG_10(expr, ...) SAFE_PRINT_ARG_INDEX(expr), (expr), SAFE_PRINT_ARG_9(__VA_ARGS__)
-#define SAFE_PRINT_ARG_11(expr, ...) SAFE_PRINT_ARG_INDEX(expr), (expr), SAFE_PRINT_ARG_10(__VA_ARGS__)
-#define SAFE_PRINT_ARG_12(expr, ...) SAFE_PRINT_ARG_INDEX(expr), (expr), SAFE_PRINT_ARG_11(__VA_ARGS__)
-#define SAFE_PRINT_ARG_13(expr, ...) SAFE_PRINT_ARG_INDEX(expr), (expr), SAFE_PRINT_ARG_12(__VA_ARGS__)
-#define SAFE_PRINT_ARG_14(expr, ...) SAFE_PRINT_ARG_INDEX(expr), (expr), SAFE_PRINT_ARG_13(__VA_ARGS__)
-#define SAFE_PRINT_ARG_15(expr, ...) SAFE_PRINT_ARG_INDEX(expr), (expr), SAFE_PRINT_ARG_14(__VA_ARGS__)
-#define SAFE_PRINT_ARG_16(expr, ...) SAFE_PRINT_ARG_INDEX(expr), (expr), SAFE_PRINT_ARG_15(__VA_ARGS__)
-
-#define SAFE_PRINT_VA_NUM_2(X, X16, X15, X14, X13, X12, X11, X10, X9, X8, X7, X6, X5, X4, X3, X2, X1, N, ...) N
-#define SAFE_PRINT_VA_NUM(...) SAFE_PRINT_VA_NUM_2(0, ## __VA_ARGS__, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
-
-#define SAFE_PRINT_ARG_N3(N, ...) SAFE_PRINT_ARG_ ## N(__VA_ARGS__)
-#define SAFE_PRINT_ARG_N2(N, ...) SAFE_PRINT_ARG_N3(N, __VA_ARGS__)
-#define SAFE_PRINT_ARG_N(...)     SAFE_PRINT_ARG_N2(SAFE_PRINT_VA_NUM(__VA_ARGS__), __VA_ARGS__)
-
-
-#define safe_print(fmt, ...) safe_print_implementation(SafePrintStdOut, (fmt), SAFE_PRINT_ARG_N(__VA_ARGS__) 0)
-#define safe_print_file(file, fmt, ...) safe_print_implementation((file), (fmt), SAFE_PRINT_ARG_N(__VA_ARGS__) 0)
-
-
-#if defined(SAFE_PRINT_IMPLEMENTATION)
-
-#include <stdarg.h>
-#include <stdint.h>
-
-
-#define SAFE_PRINT_BASE(value) (value ? value : 10)
-
-#if defined(SAFE_PRINT_DEBUG)
-#define SAFE_PRINT_DEBUG_ERROR_LOCATION(context, location) (context)->error_location = (location)
-#else
-#define SAFE_PRINT_DEBUG_ERROR_LOCATION(context, location)
-#endif
-
-
 typedef int32_t  sp_s32;
 typedef uint32_t sp_u32;
 typedef int64_t  sp_s64;
 typedef uint64_t sp_u64;
+typedef float    sp_r32;
 typedef double   sp_r64;
 typedef int      sp_b32;
 
@@ -304,26 +415,8 @@ enum {
     SAFE_PRINT_CHR,
     SAFE_PRINT_STR,
     SAFE_PRINT_PTR,
-};
-
-static int TypeLookupTable[] = {
-    0,
-    SAFE_PRINT_I32,
-    SAFE_PRINT_U32,
-    SAFE_PRINT_I32,
-    SAFE_PRINT_U32,
-    SAFE_PRINT_I32,
-    SAFE_PRINT_U32,
-    sizeof(long) > sizeof(int) ? SAFE_PRINT_I64 : SAFE_PRINT_I32,
-    sizeof(unsigned long) > sizeof(unsigned int) ? SAFE_PRINT_U64 : SAFE_PRINT_U32,
-    sizeof(long long) > sizeof(int) ? SAFE_PRINT_I64 : SAFE_PRINT_I32,
-    sizeof(unsigned long long) > sizeof(unsigned int) ? SAFE_PRINT_U64 : SAFE_PRINT_U32,
-    SAFE_PRINT_R64,
-    SAFE_PRINT_R64,
-    SAFE_PRINT_STR,
-    SAFE_PRINT_STR,
-    SAFE_PRINT_PTR,
-    SAFE_PRINT_PTR
+    SAFE_PRINT_STR_REF,
+    SAFE_PRINT_R32,
 };
 
 typedef struct SafePrintStringRef {
@@ -331,6 +424,17 @@ typedef struct SafePrintStringRef {
     int length;
 } SafePrintStringRef;
 
+/*
+ * A string with a known length, it doesn't need to be terminated with a 0.
+ * safe_print("{}\n", sp_str(packet + 4, header_length));
+ */
+static inline SafePrintStringRef sp_str(char const *data, size_t length) {
+    SafePrintStringRef str;
+    str.data = data;
+    str.length = (int)length;
+    return str;
+}
+
 
 typedef struct SafePrintFormatArg {
     int kind;
@@ -339,12 +443,23 @@ typedef struct SafePrintFormatArg {
         sp_u32 u32;
         sp_s64 s64;
         sp_u64 u64;
+        sp_r32 r32;
         sp_r64 r64;
         char const* str;
         void const* ptr;
+        SafePrintStringRef str_ref;
     };
 } SafePrintFormatArg;
 
+/*
+ * The arguments of a call captured once with safe_print_args(), so they can be handed
+ * on to safe_vprint_file and safe_vprint_buffer as often as needed.
+ */
+typedef struct SafePrintArgs {
+    SafePrintFormatArg const *args;
+    int count;
+} SafePrintArgs;
+
 enum {
     SP_FI_ALIGN_DEFAULT,
     SP_FI_ALIGN_LEFT,
@@ -368,914 +483,3833 @@ typedef struct SafePrintFormatInfo {
     sp_u32 fill;
 } SafePrintFormatInfo;
 
+/*
+ * A format string parsed ahead of time by safe_print_compile. Literal text is only
+ * referenced, so the format string has to stay valid as long as the compiled format is used.
+ */
+#if !defined(SAFE_PRINT_MAX_FORMAT_OPS)
+#define SAFE_PRINT_MAX_FORMAT_OPS 32
+#endif
 
 enum {
-    SP_FT_UNKOWN,
-    SP_FT_END_OF_INPUT,
-    SP_FT_NUMBER,
-    SP_FT_STRING,
-    SP_FT_KEYWORD_MIN,
-    SP_FT_KEYWORD_MAX,
-    SP_FT_KEYWORD_LEFT,
-    SP_FT_KEYWORD_RIGHT,
-    SP_FT_KEYWORD_FILL,
-    SP_FT_KEYWORD_PREC,
-    SP_FT_KEYWORD_BASE,
-    SP_FT_KEYWORD_SCI,
-    SP_FT_KEYWORD_SIGN,
-    SP_FT_KEYWORD_UPPER,
-    SP_FT_KEYWORD_LOWER,
-    SP_FT_BASE_BIN,
-    SP_FT_BASE_OCT,
-    SP_FT_BASE_DEC,
-    SP_FT_BASE_HEX,
-    SP_FT_SEPERATOR,
-    SP_FT_OPENING_PAREN,
-    SP_FT_CLOSING_PAREN,
-    SP_FT_OPENING_BRACE,
-    SP_FT_CLOSING_BRACE,
+    SP_OP_LITERAL,
+    SP_OP_ARG,
 };
-typedef struct SafePrintFormatToken {
-    sp_u32 kind;
+typedef struct SafePrintFormatOp {
+    sp_s32 kind;
     union {
-        sp_s32 number;
-        sp_u32 character;
-        SafePrintStringRef string;
+        SafePrintStringRef literal;
+        SafePrintFormatInfo info;
     };
-#if defined(SAFE_PRINT_DEBUG)
-    sp_s32 location;
-#endif // defined(SAFE_PRINT_DEBUG)
-} SafePrintFormatToken;
-
+} SafePrintFormatOp;
 
-typedef struct SafePrintContext {
-    char const *fmt_start;
-    char const *fmt;
-    
-    SafePrintFileType file;
-    
-    sp_s32 written;
+typedef struct SafePrintCompiledFormat {
     sp_s32 error;
-    
-#if defined(SAFE_PRINT_DEBUG)
-    sp_s32 error_location;
-#endif // defined(SAFE_PRINT_DEBUG)
-    
-    sp_s32 current_index;
     sp_s32 arg_count;
-    SafePrintFormatArg args[16];
-} SafePrintContext;
+    sp_s32 op_count;
+    SafePrintFormatOp ops[SAFE_PRINT_MAX_FORMAT_OPS];
+} SafePrintCompiledFormat;
 
+/*
+ * Size of the staging buffer every call formats into. The buffer is handed to
+ * safe_print_output_string when it is full and once at the end of the call.
+ */
+#if !defined(SAFE_PRINT_BUFFER_SIZE)
+#define SAFE_PRINT_BUFFER_SIZE 512
+#endif
 
+int safe_print_implementation(SafePrintFileType handle, char const *fmt, SafePrintFormatArg const *args, int arg_count);
+int safe_print_buffer_implementation(char *buffer, size_t size, char const *fmt, SafePrintFormatArg const *args, int arg_count);
 
-static sp_s64 safe_print_cstring_length(char const *str) {
-    sp_s64 length = 0;
-    while (str[0]) {
-        length += 1;
-        str += 1;
-    }
-    
-    return length;
-}
+/*
+ * A destination of safe_print_sinks. With write set the output goes to the callback
+ * together with user, otherwise to the file. The callback returns 0 when it took the
+ * data and anything else when it failed.
+ */
+typedef int SafePrintSinkWrite(void *user, char const *data, size_t length);
 
-static char safe_print_to_lower(char c) {
-    if (c >= 'A' && c <= 'Z') return c + 32;
-    
-    return c;
-}
+typedef struct SafePrintSink {
+    SafePrintFileType file;
+    SafePrintSinkWrite *write;
+    void *user;
+} SafePrintSink;
 
-static char safe_print_to_upper(char c) {
-    if (c >= 'a' && c <= 'z') return c - 32;
-    
-    return c;
-}
+// NOTE: A call tracks the failed sinks in a 64 bit mask.
+#define SAFE_PRINT_MAX_SINKS 64
 
-static sp_s32 safe_print_compare_string(SafePrintStringRef token, char const *str, sp_s32 length) {
-    if (token.length != length) return sp_false;
-    
-    for (sp_s32 i = 0; i < length; i += 1) {
-        if (token.data[i] != str[i]) return sp_false;
-    }
-    
-    return sp_true;
-}
+int safe_print_sinks_implementation(SafePrintSink const *sinks, int sink_count, char const *fmt, SafePrintFormatArg const *args, int arg_count);
+
+/*
+ * Levels of the leveled macros. Calls below SAFE_PRINT_MIN_LEVEL are removed by the
+ * preprocessor, the others only print at or above safe_print_runtime_level.
+ */
+#define SAFE_PRINT_LEVEL_TRACE 0
+#define SAFE_PRINT_LEVEL_DEBUG 1
+#define SAFE_PRINT_LEVEL_INFO  2
+#define SAFE_PRINT_LEVEL_WARN  3
+#define SAFE_PRINT_LEVEL_ERROR 4
 
-#if !defined(SAFE_PRINT_USE_OWN_INTEGER_CONVERSION) && !defined(SAFE_PRINT_USE_OWN_FLOAT_CONVERSION)
+#if !defined(SAFE_PRINT_MIN_LEVEL)
+#define SAFE_PRINT_MIN_LEVEL SAFE_PRINT_LEVEL_TRACE
+#endif
 
-static void safe_print_append_buffer(char *buffer, sp_s32 *size, sp_u32 c) {
-    buffer[*size] = c;
-    *size += 1;
-}
+extern int safe_print_runtime_level;
+void safe_print_set_runtime_level(int level);
 
-static char SafePrintCharacterLookup[] = "0123456789abcdefghijklmnopqrstuvwxyz";
-static char SafePrintCharacterLookupUppercase[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+int safe_vprint_file(SafePrintFileType handle, char const *fmt, SafePrintArgs args);
+int safe_vprint_buffer(char *buffer, size_t size, char const *fmt, SafePrintArgs args);
 
+SafePrintCompiledFormat safe_print_compile(char const *fmt);
+int safe_print_compiled_implementation(SafePrintFileType handle, SafePrintCompiledFormat const *format, SafePrintFormatArg const *args, int arg_count);
+
+int safe_print_ops_implementation(SafePrintFileType handle, SafePrintFormatOp const *ops, int op_count, SafePrintFormatArg const *args, int arg_count);
+int safe_print_buffer_ops_implementation(char *buffer, size_t size, SafePrintFormatOp const *ops, int op_count, SafePrintFormatArg const *args, int arg_count);
+
+#if defined(SAFE_PRINT_FORMAT_CACHE_SIZE)
+/*
+ * Hits and misses of the format cache of the calling thread.
+ */
+typedef struct SafePrintFormatCacheStats {
+    sp_u64 hits;
+    sp_u64 misses;
+} SafePrintFormatCacheStats;
+
+SafePrintFormatCacheStats safe_print_format_cache_stats(void);
 #endif
 
-#if defined(SAFE_PRINT_USE_OWN_INTEGER_CONVERSION)
+#if defined(SAFE_PRINT_THREAD_BUFFER_SIZE)
+/*
+ * Number of files a thread buffers at the same time, each gets SAFE_PRINT_THREAD_BUFFER_SIZE bytes.
+ */
+#if !defined(SAFE_PRINT_THREAD_BUFFER_FILES)
+#define SAFE_PRINT_THREAD_BUFFER_FILES 4
+#endif
 
-static SafePrintStringRef safe_print_convert_signed_to_string(char *buffer, sp_s32 size, sp_s64 signed_number, sp_s32 base, sp_s32 uppercase, sp_b32 keep_sign);
-static SafePrintStringRef safe_print_convert_unsigned_to_string(char *buffer, sp_s32 size, sp_u64 number, sp_s32 base, sp_s32 uppercase);
+enum {
+    SAFE_PRINT_FLUSH_FULL, // write the buffer when the next output does not fit anymore
+    SAFE_PRINT_FLUSH_LINE, // write the buffer at the end of every line
+};
 
-#else
+void safe_print_flush_policy(int policy);
+int  safe_print_flush(void);
+#endif
 
-static SafePrintStringRef safe_print_convert_signed_to_string(char *buffer, sp_s32 size, sp_s64 signed_number, sp_s32 base, sp_s32 uppercase, sp_b32 keep_sign) {
-    sp_s32 is_negative;
-    sp_u64 number;
-    
-    if (signed_number < 0) {
-        is_negative = 1;
-        number = -signed_number;
-    } else {
-        is_negative = 0;
-        number = signed_number;
-    }
-    
-    char *lookup = uppercase ? SafePrintCharacterLookupUppercase : SafePrintCharacterLookup;
-    
-    char *ptr = buffer + (size - 1);
-    sp_s32 written = 0;
-    do {
-        sp_s64 quot = number / base;
-        sp_s64 rem  = number % base;
-        
-        *ptr = lookup[rem];
-        ptr -= 1;
-        written += 1;
-        number = quot;
-    } while (number && written < size);
-    
-    if (is_negative || keep_sign) {
-        ptr[0] = is_negative ? '-' : '+';
-        written += 1;
-    } else {
-        ptr += 1;
-    }
-    
-    SafePrintStringRef result = {ptr, written};
-    return result;
+#if defined(SAFE_PRINT_ASYNC)
+/*
+ * Number of slots in the queue of the background thread (has to be a power of 2), the
+ * space inside each slot for copies of string arguments and the arguments a slot holds.
+ */
+#if !defined(SAFE_PRINT_ASYNC_QUEUE_SIZE)
+#define SAFE_PRINT_ASYNC_QUEUE_SIZE 1024
+#endif
+
+#if !defined(SAFE_PRINT_ASYNC_STRING_SPACE)
+#define SAFE_PRINT_ASYNC_STRING_SPACE 256
+#endif
+
+#if !defined(SAFE_PRINT_ASYNC_MAX_ARGS)
+#define SAFE_PRINT_ASYNC_MAX_ARGS 16
+#endif
+
+enum {
+    SAFE_PRINT_ASYNC_BLOCK,       // wait until the background thread made room
+    SAFE_PRINT_ASYNC_DROP,        // drop the record
+    SAFE_PRINT_ASYNC_COUNT_DROPS, // drop the record and count it, see safe_print_async_dropped
+};
+
+int  safe_print_async_start(int overflow_policy);
+void safe_print_async_stop(void);
+unsigned long long safe_print_async_dropped(void);
+int  safe_print_async_implementation(SafePrintFileType handle, char const *fmt, SafePrintFormatArg const *args, int arg_count);
+#endif // defined(SAFE_PRINT_ASYNC)
+
+/*
+ * Binary logs store a compact record per call instead of the formatted text. Every format
+ * string gets an id the first time it is used with a log, so the table has to be able to
+ * hold all distinct format strings (has to be a power of 2).
+ */
+#if !defined(SAFE_PRINT_BINARY_MAX_FORMATS)
+#define SAFE_PRINT_BINARY_MAX_FORMATS 256
+#endif
+
+/*
+ * A log keeps a copy of every format string it has seen, so a format is found by its
+ * text even when the caller reuses the buffer it is in. The copies share this many bytes.
+ */
+#if !defined(SAFE_PRINT_BINARY_FORMAT_SPACE)
+#define SAFE_PRINT_BINARY_FORMAT_SPACE 16384
+#endif
+
+typedef struct SafePrintBinaryLog {
+    SafePrintFileType file;
+    int format_count;
+    int text_used;
+    struct {
+        unsigned int hash;
+        unsigned int length;
+        int text;
+        int id;
+    } formats[SAFE_PRINT_BINARY_MAX_FORMATS];
+    struct {
+        char const *fmt;
+        int slot;
+    } recent[SAFE_PRINT_BINARY_MAX_FORMATS];
+    char text[SAFE_PRINT_BINARY_FORMAT_SPACE];
+} SafePrintBinaryLog;
+
+int safe_print_binary_open(SafePrintBinaryLog *log, SafePrintFileType file);
+int safe_print_binary_implementation(SafePrintBinaryLog *log, char const *fmt, SafePrintFormatArg const *args, int arg_count);
+int safe_print_binary_decode(SafePrintFileType handle, void const *data, size_t size);
+
+#if defined(SAFE_PRINT_FLIGHT_RECORDER)
+/*
+ * Longest record a flight recorder keeps, everything after it is cut off.
+ */
+#if !defined(SAFE_PRINT_RECORDER_MAX_RECORD)
+#define SAFE_PRINT_RECORDER_MAX_RECORD 1024
+#endif
+
+typedef struct SafePrintFlightRecorder {
+    void *memory;
+    size_t size;
+    int mapped;
+} SafePrintFlightRecorder;
+
+int  safe_print_recorder_open(SafePrintFlightRecorder *recorder, char const *path, size_t size);
+int  safe_print_recorder_attach(SafePrintFlightRecorder *recorder, void *memory, size_t size);
+void safe_print_recorder_close(SafePrintFlightRecorder *recorder);
+int  safe_print_recorder_implementation(SafePrintFlightRecorder *recorder, char const *fmt, SafePrintFormatArg const *args, int arg_count);
+int  safe_print_recorder_dump(SafePrintFileType handle, void const *data, size_t size);
+#endif // defined(SAFE_PRINT_FLIGHT_RECORDER)
+
+
+enum {
+    SP_ERROR_TOO_MANY_ARGUMENTS          = -1,
+    SP_ERROR_POSITIONAL_ARG_OUT_OF_RANGE = -2,
+    SP_ERROR_UNKNOWN_FORMAT_SPECIFIER    = -3,
+    SP_ERROR_MISSING_BRACE               = -4,
+    SP_ERROR_QUEUE_FULL                  = -5,
+    SP_ERROR_TOO_MANY_FORMATS            = -6,
+    SP_ERROR_CORRUPT_BINARY_LOG          = -7,
+    SP_ERROR_FORMAT_TOO_LONG             = -8,
+    SP_ERROR_CORRUPT_RECORDER            = -9,
+    SP_ERROR_RECORDER_NOT_OPEN           = -10,
+    SP_ERROR_ARGUMENT_COUNT_MISMATCH     = -11,
+    SP_ERROR_TOO_MANY_SINKS              = -12,
+};
+
+/*
+ * Every argument is turned into a SafePrintFormatArg at the call site. The functions
+ * decide on the kind, so the implementation doesn't need to look at the C type anymore.
+ */
+static inline SafePrintFormatArg safe_print_arg_s32(sp_s32 value) {
+    SafePrintFormatArg arg;
+    arg.kind = SAFE_PRINT_I32;
+    arg.s32 = value;
+    return arg;
 }
 
-static SafePrintStringRef safe_print_convert_unsigned_to_string(char *buffer, sp_s32 size, sp_u64 number, sp_s32 base, sp_s32 uppercase) {
-    char *lookup = uppercase ? SafePrintCharacterLookupUppercase : SafePrintCharacterLookup;
-    
-    char *ptr = buffer + size;
-    sp_s32 written = 0;
-    do {
-        sp_u64 quot = number / base;
-        sp_u64 rem  = number % base;
-        
-        ptr -= 1;
-        *ptr = lookup[rem];
-        written += 1;
-        number = quot;
-    } while (number && written < size);
-    
-    SafePrintStringRef result = {ptr, written};
-    return result;
+static inline SafePrintFormatArg safe_print_arg_u32(sp_u32 value) {
+    SafePrintFormatArg arg;
+    arg.kind = SAFE_PRINT_U32;
+    arg.u32 = value;
+    return arg;
 }
 
-#endif // defined(SAFE_PRINT_USE_OWN_INTEGER_CONVERSION)
+static inline SafePrintFormatArg safe_print_arg_s64(sp_s64 value) {
+    SafePrintFormatArg arg;
+    arg.kind = SAFE_PRINT_I64;
+    arg.s64 = value;
+    return arg;
+}
 
-#if defined(SAFE_PRINT_USE_OWN_FLOAT_CONVERSION)
+static inline SafePrintFormatArg safe_print_arg_u64(sp_u64 value) {
+    SafePrintFormatArg arg;
+    arg.kind = SAFE_PRINT_U64;
+    arg.u64 = value;
+    return arg;
+}
 
-static SafePrintStringRef safe_print_convert_double_to_string(char *buffer, sp_s32 size, sp_r64 number, sp_s32 precision, sp_b32 scientific, sp_b32 hex, sp_b32 uppercase, sp_b32 keep_sign);
+// NOTE: long is either 32 or 64 bit depending on the platform.
+static inline SafePrintFormatArg safe_print_arg_long(long long value) {
+    return sizeof(long) > sizeof(int) ? safe_print_arg_s64(value) : safe_print_arg_s32((sp_s32)value);
+}
+
+static inline SafePrintFormatArg safe_print_arg_ulong(unsigned long long value) {
+    return sizeof(unsigned long) > sizeof(unsigned int) ? safe_print_arg_u64(value) : safe_print_arg_u32((sp_u32)value);
+}
+
+static inline SafePrintFormatArg safe_print_arg_r32(sp_r32 value) {
+    SafePrintFormatArg arg;
+    arg.kind = SAFE_PRINT_R32;
+    arg.r32 = value;
+    return arg;
+}
+
+static inline SafePrintFormatArg safe_print_arg_r64(sp_r64 value) {
+    SafePrintFormatArg arg;
+    arg.kind = SAFE_PRINT_R64;
+    arg.r64 = value;
+    return arg;
+}
+
+static inline SafePrintFormatArg safe_print_arg_str(char const *value) {
+    SafePrintFormatArg arg;
+    arg.kind = SAFE_PRINT_STR;
+    arg.str = value;
+    return arg;
+}
+
+static inline SafePrintFormatArg safe_print_arg_ptr(void const *value) {
+    SafePrintFormatArg arg;
+    arg.kind = SAFE_PRINT_PTR;
+    arg.ptr = value;
+    return arg;
+}
+
+static inline SafePrintFormatArg safe_print_arg_str_ref(SafePrintStringRef value) {
+    SafePrintFormatArg arg;
+    arg.kind = SAFE_PRINT_STR_REF;
+    arg.str_ref = value;
+    return arg;
+}
+
+/*
+ * A generic macro to pick the constructor for the type of the argument.
+ * unsigned int is passed on as a signed 32 bit integer, like it always was.
+ */
+#define SAFE_PRINT_ARG(expr) _Generic((expr),		\
+char:			safe_print_arg_s32,	\
+unsigned char:		safe_print_arg_u32,	\
+short:			safe_print_arg_s32,	\
+unsigned short:		safe_print_arg_u32,	\
+int:			safe_print_arg_s32,	\
+unsigned int:		safe_print_arg_s32,	\
+long:			safe_print_arg_long,	\
+unsigned long:		safe_print_arg_ulong,	\
+long long:		safe_print_arg_s64,	\
+unsigned long long:	safe_print_arg_u64,	\
+float:			safe_print_arg_r32,	\
+double:			safe_print_arg_r64,	\
+char const*:		safe_print_arg_str,	\
+char*:			safe_print_arg_str,	\
+void const*:		safe_print_arg_ptr,	\
+void*:			safe_print_arg_ptr,	\
+SafePrintStringRef:	safe_print_arg_str_ref	\
+)(expr)
+
+/*
+ * As the variadic macro mechanism of C is of quite limited use, as you can't do any recursion,
+ * we have to specify the number of recursions beforehand.
+ * If 32 arguments are not enough you need to make this list longer and append to the VA_NUM macro.
+ */
+#define SAFE_PRINT_ARG_0()
+#define SAFE_PRINT_ARG_1(expr)       SAFE_PRINT_ARG(expr),
+#define SAFE_PRINT_ARG_2(expr, ...)  SAFE_PRINT_ARG(expr), SAFE_PRINT_ARG_1(__VA_ARGS__)
+#define SAFE_PRINT_ARG_3(expr, ...)  SAFE_PRINT_ARG(expr), SAFE_PRINT_ARG_2(__VA_ARGS__)
+#define SAFE_PRINT_ARG_4(expr, ...)  SAFE_PRINT_ARG(expr), SAFE_PRINT_ARG_3(__VA_ARGS__)
+#define SAFE_PRINT_ARG_5(expr, ...)  SAFE_PRINT_ARG(expr), SAFE_PRINT_ARG_4(__VA_ARGS__)
+#define SAFE_PRINT_ARG_6(expr, ...)  SAFE_PRINT_ARG(expr), SAFE_PRINT_ARG_5(__VA_ARGS__)
+#define SAFE_PRINT_ARG_7(expr, ...)  SAFE_PRINT_ARG(expr), SAFE_PRINT_ARG_6(__VA_ARGS__)
+#define SAFE_PRINT_ARG_8(expr, ...)  SAFE_PRINT_ARG(expr), SAFE_PRINT_ARG_7(__VA_ARGS__)
+#define SAFE_PRINT_ARG_9(expr, ...)  SAFE_PRINT_ARG(expr), SAFE_PRINT_ARG_8(__VA_ARGS__)
+#define SAFE_PRINT_ARG_10(expr, ...) SAFE_PRINT_ARG(expr), SAFE_PRINT_ARG_9(__VA_ARGS__)
+#define SAFE_PRINT_ARG_11(expr, ...) SAFE_PRINT_ARG(expr), SAFE_PRINT_ARG_10(__VA_ARGS__)
+#define SAFE_PRINT_ARG_12(expr, ...) SAFE_PRINT_ARG(expr), SAFE_PRINT_ARG_11(__VA_ARGS__)
+#define SAFE_PRINT_ARG_13(expr, ...) SAFE_PRINT_ARG(expr), SAFE_PRINT_ARG_12(__VA_ARGS__)
+#define SAFE_PRINT_ARG_14(expr, ...) SAFE_PRINT_ARG(expr), SAFE_PRINT_ARG_13(__VA_ARGS__)
+#define SAFE_PRINT_ARG_15(expr, ...) SAFE_PRINT_ARG(expr), SAFE_PRINT_ARG_14(__VA_ARGS__)
+#define SAFE_PRINT_ARG_16(expr, ...) SAFE_PRINT_ARG(expr), SAFE_PRINT_ARG_15(__VA_ARGS__)
+#define SAFE_PRINT_ARG_17(expr, ...) SAFE_PRINT_ARG(expr), SAFE_PRINT_ARG_16(__VA_ARGS__)
+#define SAFE_PRINT_ARG_18(expr, ...) SAFE_PRINT_ARG(expr), SAFE_PRINT_ARG_17(__VA_ARGS__)
+#define SAFE_PRINT_ARG_19(expr, ...) SAFE_PRINT_ARG(expr), SAFE_PRINT_ARG_18(__VA_ARGS__)
+#define SAFE_PRINT_ARG_20(expr, ...) SAFE_PRINT_ARG(expr), SAFE_PRINT_ARG_19(__VA_ARGS__)
+#define SAFE_PRINT_ARG_21(expr, ...) SAFE_PRINT_ARG(expr), SAFE_PRINT_ARG_20(__VA_ARGS__)
+#define SAFE_PRINT_ARG_22(expr, ...) SAFE_PRINT_ARG(expr), SAFE_PRINT_ARG_21(__VA_ARGS__)
+#define SAFE_PRINT_ARG_23(expr, ...) SAFE_PRINT_ARG(expr), SAFE_PRINT_ARG_22(__VA_ARGS__)
+#define SAFE_PRINT_ARG_24(expr, ...) SAFE_PRINT_ARG(expr), SAFE_PRINT_ARG_23(__VA_ARGS__)
+#define SAFE_PRINT_ARG_25(expr, ...) SAFE_PRINT_ARG(expr), SAFE_PRINT_ARG_24(__VA_ARGS__)
+#define SAFE_PRINT_ARG_26(expr, ...) SAFE_PRINT_ARG(expr), SAFE_PRINT_ARG_25(__VA_ARGS__)
+#define SAFE_PRINT_ARG_27(expr, ...) SAFE_PRINT_ARG(expr), SAFE_PRINT_ARG_26(__VA_ARGS__)
+#define SAFE_PRINT_ARG_28(expr, ...) SAFE_PRINT_ARG(expr), SAFE_PRINT_ARG_27(__VA_ARGS__)
+#define SAFE_PRINT_ARG_29(expr, ...) SAFE_PRINT_ARG(expr), SAFE_PRINT_ARG_28(__VA_ARGS__)
+#define SAFE_PRINT_ARG_30(expr, ...) SAFE_PRINT_ARG(expr), SAFE_PRINT_ARG_29(__VA_ARGS__)
+#define SAFE_PRINT_ARG_31(expr, ...) SAFE_PRINT_ARG(expr), SAFE_PRINT_ARG_30(__VA_ARGS__)
+#define SAFE_PRINT_ARG_32(expr, ...) SAFE_PRINT_ARG(expr), SAFE_PRINT_ARG_31(__VA_ARGS__)
+
+#define SAFE_PRINT_VA_NUM_2(X, X32, X31, X30, X29, X28, X27, X26, X25, X24, X23, X22, X21, X20, X19, X18, X17, X16, X15, X14, X13, X12, X11, X10, X9, X8, X7, X6, X5, X4, X3, X2, X1, N, ...) N
+#define SAFE_PRINT_VA_NUM(...) SAFE_PRINT_VA_NUM_2(0, ## __VA_ARGS__, 32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+
+#define SAFE_PRINT_ARG_N3(N, ...) SAFE_PRINT_ARG_ ## N(__VA_ARGS__)
+#define SAFE_PRINT_ARG_N2(N, ...) SAFE_PRINT_ARG_N3(N, __VA_ARGS__)
+#define SAFE_PRINT_ARG_N(...)     SAFE_PRINT_ARG_N2(SAFE_PRINT_VA_NUM(__VA_ARGS__), __VA_ARGS__)
+
+// NOTE: The array always has one more element, so it isn't empty without arguments.
+#define SAFE_PRINT_ARGS(...) (SafePrintFormatArg[]){ SAFE_PRINT_ARG_N(__VA_ARGS__) {0} }, SAFE_PRINT_VA_NUM(__VA_ARGS__)
+
+
+#define safe_print(fmt, ...) safe_print_implementation(SafePrintStdOut, (fmt), SAFE_PRINT_ARGS(__VA_ARGS__))
+#define safe_print_file(file, fmt, ...) safe_print_implementation((file), (fmt), SAFE_PRINT_ARGS(__VA_ARGS__))
+#define safe_print_buffer(buffer, size, fmt, ...) safe_print_buffer_implementation((buffer), (size), (fmt), SAFE_PRINT_ARGS(__VA_ARGS__))
+#define safe_print_sinks(sinks, sink_count, fmt, ...) safe_print_sinks_implementation((sinks), (sink_count), (fmt), SAFE_PRINT_ARGS(__VA_ARGS__))
 
+// NOTE: The runtime level is a relaxed atomic, so safe_print_set_runtime_level can change it while
+//       other threads print. A relaxed load is a plain load on the usual targets.
+#if defined(__GNUC__) || defined(__clang__)
+#define SAFE_PRINT_RUNTIME_LEVEL() __atomic_load_n(&safe_print_runtime_level, __ATOMIC_RELAXED)
 #else
+#define SAFE_PRINT_RUNTIME_LEVEL() (*(int volatile*)&safe_print_runtime_level)
+#endif
 
-// Using STB's float conversion for simplicity. For a more elaborate explanation, see the end of the file.
+// NOTE: The arguments are only evaluated and converted when the level is enabled, filtered calls are a single branch.
+#define SAFE_PRINT_LEVEL_ENABLED(level) ((level) >= SAFE_PRINT_RUNTIME_LEVEL())
 
-#define stbsp__uint32 unsigned int
-#define stbsp__int32 signed int
+// NOTE: level is evaluated once, a constant one still lets the compiler drop calls below SAFE_PRINT_MIN_LEVEL.
+#define safe_print_log(level, file, fmt, ...) do { \
+    int safe_print_log_level = (level); \
+    if (safe_print_log_level >= SAFE_PRINT_MIN_LEVEL && SAFE_PRINT_LEVEL_ENABLED(safe_print_log_level)) safe_print_implementation((file), (fmt), SAFE_PRINT_ARGS(__VA_ARGS__)); \
+} while (0)
 
-#ifdef _MSC_VER
-#define stbsp__uint64 unsigned __int64
-#define stbsp__int64 signed __int64
+#if SAFE_PRINT_MIN_LEVEL <= SAFE_PRINT_LEVEL_TRACE
+#define safe_print_trace(fmt, ...) do { if (SAFE_PRINT_LEVEL_ENABLED(SAFE_PRINT_LEVEL_TRACE)) safe_print_implementation(SafePrintStdOut, (fmt), SAFE_PRINT_ARGS(__VA_ARGS__)); } while (0)
 #else
-#define stbsp__uint64 unsigned long long
-#define stbsp__int64 signed long long
+#define safe_print_trace(fmt, ...) do {} while (0)
 #endif
 
-#define stbsp__uint16 unsigned short
+#if SAFE_PRINT_MIN_LEVEL <= SAFE_PRINT_LEVEL_DEBUG
+#define safe_print_debug(fmt, ...) do { if (SAFE_PRINT_LEVEL_ENABLED(SAFE_PRINT_LEVEL_DEBUG)) safe_print_implementation(SafePrintStdOut, (fmt), SAFE_PRINT_ARGS(__VA_ARGS__)); } while (0)
+#else
+#define safe_print_debug(fmt, ...) do {} while (0)
+#endif
 
-#define STBSP__SPECIAL 0x7000
+#if SAFE_PRINT_MIN_LEVEL <= SAFE_PRINT_LEVEL_INFO
+#define safe_print_info(fmt, ...)  do { if (SAFE_PRINT_LEVEL_ENABLED(SAFE_PRINT_LEVEL_INFO))  safe_print_implementation(SafePrintStdOut, (fmt), SAFE_PRINT_ARGS(__VA_ARGS__)); } while (0)
+#else
+#define safe_print_info(fmt, ...)  do {} while (0)
+#endif
 
+#if SAFE_PRINT_MIN_LEVEL <= SAFE_PRINT_LEVEL_WARN
+#define safe_print_warn(fmt, ...)  do { if (SAFE_PRINT_LEVEL_ENABLED(SAFE_PRINT_LEVEL_WARN))  safe_print_implementation(SafePrintStdOut, (fmt), SAFE_PRINT_ARGS(__VA_ARGS__)); } while (0)
+#else
+#define safe_print_warn(fmt, ...)  do {} while (0)
+#endif
 
-static stbsp__int32 stbsp__real_to_str(char const **start, stbsp__uint32 *len, char *out, stbsp__int32 *decimal_pos, double value, stbsp__uint32 frac_digits);
-static stbsp__int32 stbsp__real_to_parts(stbsp__int64 *bits, stbsp__int32 *expo, double value);
+#if SAFE_PRINT_MIN_LEVEL <= SAFE_PRINT_LEVEL_ERROR
+#define safe_print_error(fmt, ...) do { if (SAFE_PRINT_LEVEL_ENABLED(SAFE_PRINT_LEVEL_ERROR)) safe_print_implementation(SafePrintStdOut, (fmt), SAFE_PRINT_ARGS(__VA_ARGS__)); } while (0)
+#else
+#define safe_print_error(fmt, ...) do {} while (0)
+#endif
 
+// NOTE: The captured arguments live until the end of the block that called safe_print_args.
+#define safe_print_args(...) ((SafePrintArgs){ SAFE_PRINT_ARGS(__VA_ARGS__) })
+#define safe_vprint(fmt, args) safe_vprint_file(SafePrintStdOut, (fmt), (args))
 
-// TODO: Check the size of the specified buffer. Currently the function expects it to just be large enough.
-static SafePrintStringRef safe_print_convert_double_to_string(char *buffer, sp_s32 size, sp_r64 number, sp_s32 precision, sp_b32 scientific, sp_b32 hex, sp_b32 uppercase, sp_b32 keep_sign) {
-    stbsp__int32 pos;
-    char const *out;
-    char tmp[512];
-    stbsp__uint32 tmp_size = 512;
-    
-    char *lookup = uppercase ? SafePrintCharacterLookupUppercase : SafePrintCharacterLookup;
+#define safe_print_compiled(format, ...) safe_print_compiled_implementation(SafePrintStdOut, (format), SAFE_PRINT_ARGS(__VA_ARGS__))
+#define safe_print_compiled_file(file, format, ...) safe_print_compiled_implementation((file), (format), SAFE_PRINT_ARGS(__VA_ARGS__))
+
+#if defined(SAFE_PRINT_ASYNC)
+#define safe_print_async(fmt, ...) safe_print_async_implementation(SafePrintStdOut, (fmt), SAFE_PRINT_ARGS(__VA_ARGS__))
+#define safe_print_async_file(file, fmt, ...) safe_print_async_implementation((file), (fmt), SAFE_PRINT_ARGS(__VA_ARGS__))
+#endif
+
+#define safe_print_binary(log, fmt, ...) safe_print_binary_implementation((log), (fmt), SAFE_PRINT_ARGS(__VA_ARGS__))
+
+#if defined(SAFE_PRINT_FLIGHT_RECORDER)
+#define safe_print_recorder(recorder, fmt, ...) safe_print_recorder_implementation((recorder), (fmt), SAFE_PRINT_ARGS(__VA_ARGS__))
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#if defined(__cplusplus) && (__cplusplus >= 202002L || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L))
+#include <concepts>
+#include <type_traits>
+
+/*
+ * C++20 front end. The format string is a template argument and is parsed by the
+ * compiler, so unknown specifiers, bad argument indices and missing arguments are
+ * compile errors. At runtime the arguments are stored with their kind known from
+ * their type and the prepared ops are formatted by the same code as safe_print.
+ *
+ * safe_print::print<"Hello {}!\n">("World");
+ * safe_print::print_file<"{min(8):hex}\n">(file, flags);
+ * safe_print::print_buffer<"{} + {} = {}">(buffer, sizeof(buffer), 1, 2, 3);
+ */
+namespace safe_print {
+
+template<size_t N>
+struct FormatString {
+    char data[N];
     
-    stbsp__int32 sign = stbsp__real_to_str(&out, &tmp_size, tmp, &pos, number, precision);
+    constexpr FormatString(char const (&str)[N]) {
+        for (size_t i = 0; i < N; i += 1) data[i] = str[i];
+    }
+};
+
+namespace detail {
+
+// NOTE: These are called while parsing at compile time to stop the compilation, the name is the error message.
+inline void error_unknown_format_specifier() {}
+inline void error_missing_brace() {}
+inline void error_bad_argument_index() {}
+inline void error_not_enough_arguments() {}
+inline void error_base_has_to_be_between_2_and_36() {}
+
+enum {
+    TOKEN_UNKNOWN,
+    TOKEN_NUMBER,
+    TOKEN_OPENING_BRACE,
+    TOKEN_CLOSING_BRACE,
+    TOKEN_OPENING_PAREN,
+    TOKEN_CLOSING_PAREN,
+    TOKEN_SEPERATOR,
+    TOKEN_STRING,
+    TOKEN_MIN,
+    TOKEN_MAX,
+    TOKEN_FILL,
+    TOKEN_PREC,
+    TOKEN_LEFT,
+    TOKEN_RIGHT,
+    TOKEN_BASE,
+    TOKEN_BIN,
+    TOKEN_OCT,
+    TOKEN_DEC,
+    TOKEN_HEX,
+    TOKEN_SCI,
+    TOKEN_SHORT,
+    TOKEN_SIGN,
+    TOKEN_LOWER,
+    TOKEN_UPPER,
+};
+
+struct Token {
+    sp_s32 kind;
+    sp_s32 number;
+};
+
+constexpr bool is_keyword(char const *str, sp_s32 length, char const *keyword) {
+    sp_s32 i = 0;
+    for (; i < length; i += 1) {
+        if (keyword[i] != str[i]) return false;
+    }
     
-    sp_s32 written = 0;
-    if (sign) safe_print_append_buffer(buffer, &written, '-');
-    else if (keep_sign) safe_print_append_buffer(buffer, &written, '+');
+    return keyword[i] == '\0';
+}
+
+/*
+ * Same grammar as safe_print_parse_format_specifier, evaluated by the compiler.
+ */
+struct Parser {
+    char const *fmt;
+    sp_s32 arg_count;
+    sp_s32 current_index;
     
-    if (pos == STBSP__SPECIAL) {
-        safe_print_append_buffer(buffer, &written, out[0]);
-        safe_print_append_buffer(buffer, &written, out[1]);
-        safe_print_append_buffer(buffer, &written, out[2]);
+    constexpr Token next_token() {
+        Token token = {};
         
-        return (SafePrintStringRef){buffer, written};
+        while (fmt[0]) {
+            char c = fmt[0];
+            
+            if (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+                fmt += 1;
+                continue;
+            }
+            
+            if (c >= '0' && c <= '9') {
+                while (fmt[0] >= '0' && fmt[0] <= '9') {
+                    token.number = token.number * 10 + (fmt[0] - '0');
+                    fmt += 1;
+                }
+                token.kind = TOKEN_NUMBER;
+                return token;
+            }
+            
+            if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))) {
+                fmt += 1;
+                switch (c) {
+                    case '{': token.kind = TOKEN_OPENING_BRACE; break;
+                    case '}': token.kind = TOKEN_CLOSING_BRACE; break;
+                    case '(': token.kind = TOKEN_OPENING_PAREN; break;
+                    case ')': token.kind = TOKEN_CLOSING_PAREN; break;
+                    case ':': token.kind = TOKEN_SEPERATOR; break;
+                    default:  token.kind = TOKEN_UNKNOWN; break;
+                }
+                return token;
+            }
+            
+            char const *str = fmt;
+            sp_s32 length = 0;
+            while ((fmt[0] >= 'a' && fmt[0] <= 'z') || (fmt[0] >= 'A' && fmt[0] <= 'Z')) {
+                length += 1;
+                fmt += 1;
+            }
+            
+            token.kind = TOKEN_STRING;
+            if      (is_keyword(str, length, "min"))       token.kind = TOKEN_MIN;
+            else if (is_keyword(str, length, "max"))       token.kind = TOKEN_MAX;
+            else if (is_keyword(str, length, "fill"))      token.kind = TOKEN_FILL;
+            else if (is_keyword(str, length, "precision")) token.kind = TOKEN_PREC;
+            else if (is_keyword(str, length, "left"))      token.kind = TOKEN_LEFT;
+            else if (is_keyword(str, length, "right"))     token.kind = TOKEN_RIGHT;
+            else if (is_keyword(str, length, "base"))      token.kind = TOKEN_BASE;
+            else if (is_keyword(str, length, "bin"))       token.kind = TOKEN_BIN;
+            else if (is_keyword(str, length, "oct"))       token.kind = TOKEN_OCT;
+            else if (is_keyword(str, length, "dec"))       token.kind = TOKEN_DEC;
+            else if (is_keyword(str, length, "hex"))       token.kind = TOKEN_HEX;
+            else if (is_keyword(str, length, "sci"))       token.kind = TOKEN_SCI;
+            else if (is_keyword(str, length, "short"))     token.kind = TOKEN_SHORT;
+            else if (is_keyword(str, length, "sign"))      token.kind = TOKEN_SIGN;
+            else if (is_keyword(str, length, "lower"))     token.kind = TOKEN_LOWER;
+            else if (is_keyword(str, length, "upper"))     token.kind = TOKEN_UPPER;
+            
+            return token;
+        }
+        
+        token.kind = TOKEN_UNKNOWN;
+        return token;
     }
     
-    if (hex) {
-        stbsp__uint64 bits;
-        stbsp__int32 expo;
-        sign = stbsp__real_to_parts((stbsp__int64*)&bits, &expo, number);
+    constexpr void expect(sp_s32 kind) {
+        if (next_token().kind != kind) error_unknown_format_specifier();
+    }
+    
+    constexpr sp_s32 parse_number_argument() {
+        expect(TOKEN_OPENING_PAREN);
+        Token number = next_token();
+        if (number.kind != TOKEN_NUMBER) error_unknown_format_specifier();
+        expect(TOKEN_CLOSING_PAREN);
         
-        if (expo == -1023)
-            expo = bits ? -1022 : 0;
-        else
-            bits |= ((stbsp__uint64)1) << 52;
+        return number.number;
+    }
+    
+    // NOTE: Expects fmt to be behind the opening brace and returns false for an escaped brace.
+    constexpr bool parse_format_specifier(SafePrintFormatInfo *out) {
+        SafePrintFormatInfo info = {};
+        info.arg_index = -1;
         
-        bits <<= 64 - 56;
-        if (precision < 15)
-            bits += (((stbsp__uint64)8) << 56) >> (precision * 4);
+        if (fmt[0] == '{') {
+            fmt += 1;
+            return false;
+        }
         
-        safe_print_append_buffer(buffer, &written, '0');
-        safe_print_append_buffer(buffer, &written, 'x');
+        Token token = {};
+        if (fmt[0] != '}') {
+            do {
+                token = next_token();
+                switch (token.kind) {
+                    case TOKEN_NUMBER: {
+                        if (token.number > arg_count) error_bad_argument_index();
+                        info.arg_index = token.number - 1;
+                    } break;
+                    
+                    case TOKEN_MIN:  { info.min = parse_number_argument(); } break;
+                    case TOKEN_MAX:  { info.max = parse_number_argument(); } break;
+                    case TOKEN_PREC: { info.precision = parse_number_argument(); } break;
+                    
+                    case TOKEN_FILL: {
+                        expect(TOKEN_OPENING_PAREN);
+                        info.fill = fmt[0];
+                        if (fmt[0]) fmt += 1;
+                        expect(TOKEN_CLOSING_PAREN);
+                    } break;
+                    
+                    case TOKEN_BASE: {
+                        info.base = parse_number_argument();
+                        if (info.base == 1 || info.base > 36) error_base_has_to_be_between_2_and_36();
+                    } break;
+                    
+                    case TOKEN_LEFT:  { info.alignment = SP_FI_ALIGN_LEFT; } break;
+                    case TOKEN_RIGHT: { info.alignment = SP_FI_ALIGN_RIGHT; } break;
+                    
+                    case TOKEN_SCI:   { info.scientific = sp_true; } break;
+                    case TOKEN_SHORT: { info.precision = 0; } break;
+                    case TOKEN_SIGN:  { info.sign = sp_true; } break;
+                    
+                    case TOKEN_LOWER: { info.char_case = SP_FI_LOWER_CASE; } break;
+                    case TOKEN_UPPER: { info.char_case = SP_FI_UPPER_CASE; } break;
+                    
+                    case TOKEN_BIN: { info.base = 2; } break;
+                    case TOKEN_OCT: { info.base = 8; } break;
+                    case TOKEN_DEC: { info.base = 10; } break;
+                    case TOKEN_HEX: { info.base = 16; } break;
+                    
+                    case TOKEN_STRING:  { error_unknown_format_specifier(); } break;
+                    case TOKEN_UNKNOWN: { error_missing_brace(); } break;
+                }
+                
+                token = next_token();
+            } while (token.kind == TOKEN_SEPERATOR);
+        } else {
+            token = next_token();
+        }
         
-        safe_print_append_buffer(buffer, &written, lookup[(bits >> 60) & 15]);
-        safe_print_append_buffer(buffer, &written, '.');
+        if (token.kind != TOKEN_CLOSING_BRACE) error_missing_brace();
         
-        bits <<= 4;
-        while (precision) {
-            safe_print_append_buffer(buffer, &written, lookup[(bits >> 60) & 15]);
-            bits <<= 4;
-            precision -= 1;
+        if (info.arg_index == -1) {
+            info.arg_index = current_index;
+            if (info.arg_index == arg_count) error_not_enough_arguments();
+            current_index += 1;
         }
-        safe_print_append_buffer(buffer, &written, uppercase ? 'P' : 'p');
         
-        char exp_buffer[4];
-        SafePrintStringRef exp_str = safe_print_convert_signed_to_string(exp_buffer, 4, expo, 10, uppercase, sp_true);
+        *out = info;
+        return true;
+    }
+};
+
+/*
+ * Splits the format string into the same ops as safe_print_compile. Without out only
+ * the ops are counted.
+ */
+constexpr sp_s32 parse_format(char const *fmt, sp_s32 arg_count, SafePrintFormatOp *out) {
+    Parser parser = {fmt, arg_count, 0};
+    sp_s32 op_count = 0;
+    
+    while (parser.fmt[0]) {
+        SafePrintFormatOp op = {};
+        op.kind = SP_OP_LITERAL;
+        op.literal.data = parser.fmt;
+        op.literal.length = 1;
         
-        for (sp_s32 i = 0; i < exp_str.length; i += 1) {
-            safe_print_append_buffer(buffer, &written, exp_str.data[i]);
+        if (parser.fmt[0] == '{') {
+            parser.fmt += 1;
+            
+            SafePrintFormatInfo info = {};
+            if (parser.parse_format_specifier(&info)) {
+                op.kind = SP_OP_ARG;
+                op.info = info;
+            }
+        } else if (parser.fmt[0] == '}') {
+            if (parser.fmt[1] != '}') error_missing_brace();
+            parser.fmt += 2;
+        } else {
+            char const *end = parser.fmt;
+            while (end[0] && end[0] != '{' && end[0] != '}') end += 1;
+            
+            op.literal.length = (int)(end - parser.fmt);
+            parser.fmt = end;
         }
-    } else if (scientific) {
-        sp_s32 exp = pos - 1;
-        char exp_buffer[4];
-        SafePrintStringRef exp_str = safe_print_convert_signed_to_string(exp_buffer, 4, exp, 10, 0, sp_true);
         
-        safe_print_append_buffer(buffer, &written, out[0]);
-        tmp_size -= 1;
-        out += 1;
+        if (out) out[op_count] = op;
+        op_count += 1;
+    }
+    
+    return op_count;
+}
+
+template<FormatString Fmt, sp_s32 ArgCount>
+struct Format {
+    static constexpr sp_s32 op_count = parse_format(Fmt.data, ArgCount, nullptr);
+    
+    struct Ops {
+        SafePrintFormatOp ops[op_count ? op_count : 1];
+    };
+    
+    static constexpr Ops build() {
+        Ops result = {};
+        parse_format(Fmt.data, ArgCount, result.ops);
         
-        safe_print_append_buffer(buffer, &written, '.');
-        while (tmp_size && precision) {
-            safe_print_append_buffer(buffer, &written, out[0]);
-            out += 1;
-            tmp_size -= 1;
-            precision -= 1;
-        }
-        while (precision) {
-            safe_print_append_buffer(buffer, &written, '0');
-            precision -= 1;
-        }
-        safe_print_append_buffer(buffer, &written, uppercase ? 'E' : 'e');
-        for (sp_s32 i = 0; i < exp_str.length; i += 1) {
-            safe_print_append_buffer(buffer, &written, exp_str.data[i]);
-        }
-    } else {
-        if (pos == 0) {
-            safe_print_append_buffer(buffer, &written, '0');
-            safe_print_append_buffer(buffer, &written, '.');
-        } else if (pos > 0) {
-            while (pos && tmp_size) {
-                safe_print_append_buffer(buffer, &written, out[0]);
-                out += 1;
-                tmp_size -= 1;
-                pos -= 1;
-            }
-            while (pos) {
-                safe_print_append_buffer(buffer, &written, '0');
-                pos -= 1;
-            }
-            safe_print_append_buffer(buffer, &written, '.');
+        return result;
+    }
+    
+    static constexpr Ops value = build();
+};
+
+template<typename T>
+struct AlwaysFalse : std::false_type {};
+
+/*
+ * Stores an argument like the constructor SAFE_PRINT_ARG picks for it in C, so
+ * the same types are accepted and printed the same way.
+ */
+template<typename T>
+inline SafePrintFormatArg make_arg(T const &value) {
+    using Type = std::decay_t<T>;
+    SafePrintFormatArg arg = {};
+    
+    if constexpr (std::is_same_v<Type, char> || std::is_same_v<Type, short> || std::is_same_v<Type, int> || std::is_same_v<Type, unsigned int>) {
+        arg.kind = SAFE_PRINT_I32;
+        arg.s32 = (sp_s32)value;
+    } else if constexpr (std::is_same_v<Type, unsigned char> || std::is_same_v<Type, unsigned short>) {
+        arg.kind = SAFE_PRINT_U32;
+        arg.u32 = (sp_u32)value;
+    } else if constexpr (std::is_same_v<Type, long> || std::is_same_v<Type, long long>) {
+        if constexpr (sizeof(Type) > sizeof(int)) {
+            arg.kind = SAFE_PRINT_I64;
+            arg.s64 = (sp_s64)value;
         } else {
-            safe_print_append_buffer(buffer, &written, '0');
-            safe_print_append_buffer(buffer, &written, '.');
-            
-            while (pos < 0 && precision) {
-                safe_print_append_buffer(buffer, &written, '0');
-                pos += 1;
-                precision -= 1;
-            }
-        }
-        
-        while (precision && tmp_size) {
-            safe_print_append_buffer(buffer, &written, out[0]);
-            out += 1;
-            tmp_size -= 1;
-            precision -= 1;
+            arg.kind = SAFE_PRINT_I32;
+            arg.s32 = (sp_s32)value;
         }
-        
-        while (precision) {
-            safe_print_append_buffer(buffer, &written, '0');
-            precision -= 1;
+    } else if constexpr (std::is_same_v<Type, unsigned long> || std::is_same_v<Type, unsigned long long>) {
+        if constexpr (sizeof(Type) > sizeof(unsigned int)) {
+            arg.kind = SAFE_PRINT_U64;
+            arg.u64 = (sp_u64)value;
+        } else {
+            arg.kind = SAFE_PRINT_U32;
+            arg.u32 = (sp_u32)value;
         }
+    } else if constexpr (std::is_same_v<Type, float>) {
+        arg.kind = SAFE_PRINT_R32;
+        arg.r32 = value;
+    } else if constexpr (std::is_same_v<Type, double>) {
+        arg.kind = SAFE_PRINT_R64;
+        arg.r64 = (sp_r64)value;
+    } else if constexpr (std::is_same_v<Type, char*> || std::is_same_v<Type, char const*>) {
+        arg.kind = SAFE_PRINT_STR;
+        arg.str = value;
+    } else if constexpr (std::is_same_v<Type, void*> || std::is_same_v<Type, void const*>) {
+        arg.kind = SAFE_PRINT_PTR;
+        arg.ptr = value;
+    } else if constexpr (std::is_same_v<Type, SafePrintStringRef>) {
+        arg.kind = SAFE_PRINT_STR_REF;
+        arg.str_ref = value;
+    } else if constexpr (requires { { value.data() } -> std::convertible_to<char const*>; value.size(); }) {
+        // NOTE: std::string, std::string_view and everything else with data() and size().
+        arg.kind = SAFE_PRINT_STR_REF;
+        arg.str_ref.data = value.data();
+        arg.str_ref.length = (int)value.size();
+    } else {
+        static_assert(AlwaysFalse<T>::value, "Argument type is not supported by safe_print.");
     }
     
-    return (SafePrintStringRef){buffer, written};
+    return arg;
 }
 
-#endif // defined(SAFE_PRINT_USE_OWN_FLOAT_CONVERSION)
+} // namespace detail
 
-#if defined(SAFE_PRINT_USE_OWN_FILE_OUTPUT)
+template<FormatString Fmt, typename... Args>
+inline int print_file(SafePrintFileType file, Args const &... args) {
+    using Format = detail::Format<Fmt, sizeof...(Args)>;
+    
+    SafePrintFormatArg values[sizeof...(Args) + 1] = {detail::make_arg(args)...};
+    return safe_print_ops_implementation(file, Format::value.ops, Format::op_count, values, sizeof...(Args));
+}
 
-static void safe_print_output_character(SafePrintContext *context, char c);
-static void safe_print_output_string(SafePrintContext *context, char const *str, size_t length);
+template<FormatString Fmt, typename... Args>
+inline int print(Args const &... args) {
+    return print_file<Fmt>(SafePrintStdOut, args...);
+}
+
+template<FormatString Fmt, typename... Args>
+inline int print_buffer(char *buffer, size_t size, Args const &... args) {
+    using Format = detail::Format<Fmt, sizeof...(Args)>;
+    
+    SafePrintFormatArg values[sizeof...(Args) + 1] = {detail::make_arg(args)...};
+    return safe_print_buffer_ops_implementation(buffer, size, Format::value.ops, Format::op_count, values, sizeof...(Args));
+}
+
+} // namespace safe_print
+#endif // C++20
+
+#endif // !defined(SAFE_PRINT_H)
+
+
+#if defined(SAFE_PRINT_IMPLEMENTATION)
+
+#include <stdint.h>
+#include <string.h>
+
+#if !defined(SAFE_PRINT_NO_SIMD)
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SAFE_PRINT_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SAFE_PRINT_SSE2
+#endif
+#endif // !defined(SAFE_PRINT_NO_SIMD)
+
+// NOTE: The brace search reads whole aligned blocks past the end of the string, which sanitizers report.
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define SAFE_PRINT_SANITIZER
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer)
+#define SAFE_PRINT_SANITIZER
+#endif
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(SAFE_PRINT_ASYNC)
+#include <stdatomic.h>
+#include <threads.h>
+#endif
+
+#if defined(SAFE_PRINT_THREAD_BUFFER_SIZE)
+#include <stdlib.h>
+#include <threads.h>
+#endif
+
+#if defined(SAFE_PRINT_FLIGHT_RECORDER)
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
+#if (defined(SAFE_PRINT_FORMAT_CACHE_SIZE) || defined(SAFE_PRINT_THREAD_BUFFER_SIZE)) && !defined(SAFE_PRINT_THREAD_LOCAL)
+#if defined(_MSC_VER)
+#define SAFE_PRINT_THREAD_LOCAL __declspec(thread)
+#elif defined(__cplusplus)
+#define SAFE_PRINT_THREAD_LOCAL thread_local
 #else
+#define SAFE_PRINT_THREAD_LOCAL _Thread_local
+#endif
+#endif
 
-static void safe_print_output_character(SafePrintContext *context, char c) {
-    if (fputc(c, context->file) == EOF) {
-        context->error = sp_true;
-    } else {
-        context->written += 1;
-    }
-}
+/*
+ * Held around every call that prints to a FILE*, the fwrites inside take the same lock again
+ * without waiting for it.
+ */
+#if defined(SAFE_PRINT_ATOMIC_RECORDS) && !defined(SAFE_PRINT_USE_FD_OUTPUT) && !defined(SAFE_PRINT_USE_OWN_FILE_OUTPUT)
+#if defined(_WIN32)
+#define safe_print_lock_file(file)   _lock_file(file)
+#define safe_print_unlock_file(file) _unlock_file(file)
+#else
+#define safe_print_lock_file(file)   flockfile(file)
+#define safe_print_unlock_file(file) funlockfile(file)
+#endif
+#else
+#define safe_print_lock_file(file)
+#define safe_print_unlock_file(file)
+#endif
 
-static void safe_print_output_string(SafePrintContext *context, char const *str, size_t length) {
-    size_t written = fwrite(str, 1, length, context->file);
-    context->written += written;
-    if (written != length) {
-        context->error = sp_true;
-    }
+#if defined(SAFE_PRINT_USE_FD_OUTPUT)
+#include <errno.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if defined(SAFE_PRINT_DEBUG)
+#include <stdio.h>
+#endif
+
+/*
+ * Number of iovecs collected for a single writev and the minimum length of a literal
+ * run or string argument that is referenced in place instead of copied to the
+ * staging buffer.
+ */
+#if !defined(SAFE_PRINT_MAX_SEGMENTS)
+#define SAFE_PRINT_MAX_SEGMENTS 32
+#endif
+
+#if !defined(SAFE_PRINT_MIN_REFERENCE_SIZE)
+#define SAFE_PRINT_MIN_REFERENCE_SIZE 64
+#endif
+#endif // defined(SAFE_PRINT_USE_FD_OUTPUT)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#define SAFE_PRINT_BASE(value) (value ? value : 10)
+
+// NOTE: A replaced float conversion gets the old default, the built in one prints the shortest representation for 0.
+#if defined(SAFE_PRINT_USE_OWN_FLOAT_CONVERSION)
+#define SAFE_PRINT_PRECISION(value) (value ? value : 6)
+#else
+#define SAFE_PRINT_PRECISION(value) (value)
+#endif
+
+#if defined(SAFE_PRINT_DEBUG)
+#define SAFE_PRINT_DEBUG_ERROR_LOCATION(context, location) (context)->error_location = (location)
+#else
+#define SAFE_PRINT_DEBUG_ERROR_LOCATION(context, location)
+#endif
+
+
+enum {
+    SP_FT_UNKOWN,
+    SP_FT_END_OF_INPUT,
+    SP_FT_NUMBER,
+    SP_FT_STRING,
+    SP_FT_KEYWORD_MIN,
+    SP_FT_KEYWORD_MAX,
+    SP_FT_KEYWORD_LEFT,
+    SP_FT_KEYWORD_RIGHT,
+    SP_FT_KEYWORD_FILL,
+    SP_FT_KEYWORD_PREC,
+    SP_FT_KEYWORD_BASE,
+    SP_FT_KEYWORD_SCI,
+    SP_FT_KEYWORD_SHORT,
+    SP_FT_KEYWORD_SIGN,
+    SP_FT_KEYWORD_UPPER,
+    SP_FT_KEYWORD_LOWER,
+    SP_FT_BASE_BIN,
+    SP_FT_BASE_OCT,
+    SP_FT_BASE_DEC,
+    SP_FT_BASE_HEX,
+    SP_FT_SEPERATOR,
+    SP_FT_OPENING_PAREN,
+    SP_FT_CLOSING_PAREN,
+    SP_FT_OPENING_BRACE,
+    SP_FT_CLOSING_BRACE,
+};
+typedef struct SafePrintFormatToken {
+    sp_u32 kind;
+    union {
+        sp_s32 number;
+        sp_u32 character;
+        SafePrintStringRef string;
+    };
+#if defined(SAFE_PRINT_DEBUG)
+    sp_s32 location;
+#endif // defined(SAFE_PRINT_DEBUG)
+} SafePrintFormatToken;
+
+
+enum {
+    SP_TARGET_FILE,
+    SP_TARGET_MEMORY,
+    SP_TARGET_SINKS,
+};
+
+typedef struct SafePrintContext {
+    char const *fmt_start;
+    char const *fmt;
+    
+    SafePrintFileType file;
+    sp_s32 target;
+    SafePrintSink const *sinks;
+    sp_s32 sink_count;
+    sp_u64 failed_sinks;
+    
+    char *buffer;
+    sp_s32 buffer_size;
+    sp_s32 buffer_used;
+    sp_s64 overflow;
+    char staging[SAFE_PRINT_BUFFER_SIZE];
+    
+#if defined(SAFE_PRINT_USE_FD_OUTPUT)
+    struct iovec segments[SAFE_PRINT_MAX_SEGMENTS];
+    sp_s32 segment_count;
+    sp_s32 segment_start;
+#endif // defined(SAFE_PRINT_USE_FD_OUTPUT)
+    
+    sp_s32 written;
+    sp_s32 error;
+    
+#if defined(SAFE_PRINT_DEBUG)
+    sp_s32 error_location;
+#endif // defined(SAFE_PRINT_DEBUG)
+    
+    sp_s32 current_index;
+    sp_s32 arg_count;
+    SafePrintFormatArg const *args;
+} SafePrintContext;
+
+
+
+#if (defined(SAFE_PRINT_AVX2) || defined(SAFE_PRINT_SSE2)) && !defined(SAFE_PRINT_SANITIZER)
+
+static sp_u32 safe_print_count_trailing_zeros(sp_u32 value) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return index;
+#else
+    return __builtin_ctz(value);
+#endif
 }
 
-#endif // defined(SAFE_PRINT_USE_OWN_FILE_OUTPUT)
+#endif // (defined(SAFE_PRINT_AVX2) || defined(SAFE_PRINT_SSE2)) && !defined(SAFE_PRINT_SANITIZER)
 
+/*
+ * Returns the length of the string, but stops looking for the terminating 0 after
+ * limit characters. Like safe_print_find_brace the fast versions only use aligned loads.
+ * Long strings are checked four blocks at a time: the unsigned minimum of the blocks
+ * only has a 0 byte if one of them has, the exact position is then found block by block.
+ */
+#if defined(SAFE_PRINT_AVX2) && !defined(SAFE_PRINT_SANITIZER)
 
-static void safe_print_apply_format_info(SafePrintContext *context, SafePrintStringRef str, SafePrintFormatInfo info, char default_fill) {
-    sp_s32 space = 0;
-    if (str.length < info.min) {
-        space = info.min - str.length;
-    }
-    if (info.max && str.length > info.max)
-        str.length = info.max;
+static sp_s64 safe_print_cstring_length_bounded(char const *str, sp_s64 limit) {
+    uintptr_t offset = (uintptr_t)str & 31;
+    char const *ptr = str - offset;
     
-    sp_s32 align = info.alignment ? info.alignment : SP_FI_ALIGN_RIGHT;
-    if (align == SP_FI_ALIGN_RIGHT) {
-        while (space) {
-            safe_print_output_character(context, info.fill ? info.fill : default_fill);
-            space -= 1;
-        }
-    }
-    safe_print_output_string(context, str.data, str.length);
-    if (align == SP_FI_ALIGN_LEFT) {
-        while (space) {
-            safe_print_output_character(context, info.fill ? info.fill : default_fill);
-            space -= 1;
+    __m256i zero = _mm256_setzero_si256();
+    
+    sp_u32 mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256((__m256i const*)ptr), zero));
+    mask &= ~(sp_u32)0 << offset;
+    
+    while (!mask) {
+        ptr += 32;
+        if (ptr - str >= limit) return limit;
+        
+        if (!((uintptr_t)ptr & 127)) {
+            while (ptr - str < limit) {
+                __m256i a = _mm256_load_si256((__m256i const*)ptr);
+                __m256i b = _mm256_load_si256((__m256i const*)(ptr + 32));
+                __m256i c = _mm256_load_si256((__m256i const*)(ptr + 64));
+                __m256i d = _mm256_load_si256((__m256i const*)(ptr + 96));
+                __m256i minimum = _mm256_min_epu8(_mm256_min_epu8(a, b), _mm256_min_epu8(c, d));
+                if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(minimum, zero))) break;
+                
+                ptr += 128;
+            }
+            if (ptr - str >= limit) return limit;
         }
+        
+        mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256((__m256i const*)ptr), zero));
     }
+    
+    sp_s64 length = ptr + safe_print_count_trailing_zeros(mask) - str;
+    return length < limit ? length : limit;
 }
 
-static void safe_print_apply_format_info_to_string(SafePrintContext *context, SafePrintStringRef str, SafePrintFormatInfo info, char default_fill) {
-    sp_s32 space = 0;
-    if (str.length < info.min) {
-        space = info.min - str.length;
-    }
-    if (info.max && str.length > info.max)
-        str.length = info.max;
+#elif defined(SAFE_PRINT_SSE2) && !defined(SAFE_PRINT_SANITIZER)
+
+static sp_s64 safe_print_cstring_length_bounded(char const *str, sp_s64 limit) {
+    uintptr_t offset = (uintptr_t)str & 15;
+    char const *ptr = str - offset;
     
-    sp_s32 align = info.alignment ? info.alignment : SP_FI_ALIGN_LEFT;
-    if (align == SP_FI_ALIGN_RIGHT) {
-        while (space) {
-            safe_print_output_character(context, info.fill ? info.fill : default_fill);
-            space -= 1;
+    __m128i zero = _mm_setzero_si128();
+    
+    sp_u32 mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((__m128i const*)ptr), zero));
+    mask &= ~(sp_u32)0 << offset;
+    
+    while (!mask) {
+        ptr += 16;
+        if (ptr - str >= limit) return limit;
+        
+        if (!((uintptr_t)ptr & 63)) {
+            while (ptr - str < limit) {
+                __m128i a = _mm_load_si128((__m128i const*)ptr);
+                __m128i b = _mm_load_si128((__m128i const*)(ptr + 16));
+                __m128i c = _mm_load_si128((__m128i const*)(ptr + 32));
+                __m128i d = _mm_load_si128((__m128i const*)(ptr + 48));
+                __m128i minimum = _mm_min_epu8(_mm_min_epu8(a, b), _mm_min_epu8(c, d));
+                if (_mm_movemask_epi8(_mm_cmpeq_epi8(minimum, zero))) break;
+                
+                ptr += 64;
+            }
+            if (ptr - str >= limit) return limit;
         }
+        
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((__m128i const*)ptr), zero));
     }
     
-    if (info.char_case == SP_FI_UPPER_CASE) {
-        for (sp_s32 i = 0; i < str.length; i += 1) {
-            safe_print_output_character(context, safe_print_to_upper(str.data[i]));
-        }
-    } else if (info.char_case == SP_FI_LOWER_CASE) {
-        for (sp_s32 i = 0; i < str.length; i += 1) {
-            safe_print_output_character(context, safe_print_to_lower(str.data[i]));
-        }
-    } else {
-        safe_print_output_string(context, str.data, str.length);
+    sp_s64 length = ptr + safe_print_count_trailing_zeros(mask) - str;
+    return length < limit ? length : limit;
+}
+
+#elif !defined(SAFE_PRINT_SANITIZER)
+
+static sp_s64 safe_print_cstring_length_bounded(char const *str, sp_s64 limit) {
+    sp_s64 length = 0;
+    while (((uintptr_t)(str + length) & (sizeof(uintptr_t) - 1)) && length < limit) {
+        if (!str[length]) return length;
+        length += 1;
     }
     
-    if (align == SP_FI_ALIGN_LEFT) {
-        while (space) {
-            safe_print_output_character(context, info.fill ? info.fill : default_fill);
-            space -= 1;
-        }
+    // NOTE: A word has a 0 byte when subtracting 1 from every byte borrows into a cleared high bit.
+    uintptr_t ones  = (uintptr_t)-1 / 0xFF;
+    uintptr_t highs = ones << 7;
+    while (length < limit) {
+        uintptr_t word;
+        memcpy(&word, str + length, sizeof(word));
+        if ((word - ones) & ~word & highs) break;
+        
+        length += sizeof(word);
     }
     
+    while (length < limit && str[length]) length += 1;
+    
+    return length < limit ? length : limit;
 }
 
-static void safe_print_format_arg(SafePrintContext *context, SafePrintFormatInfo info) {
-    SafePrintFormatArg *arg = &context->args[info.arg_index];
+#else
+
+static sp_s64 safe_print_cstring_length_bounded(char const *str, sp_s64 limit) {
+    sp_s64 length = 0;
+    while (length < limit && str[length]) length += 1;
     
-    switch (arg->kind) {
-        case SAFE_PRINT_I32: {
-            char buffer[128];
-            SafePrintStringRef str = safe_print_convert_signed_to_string(buffer, 128, arg->s32, SAFE_PRINT_BASE(info.base), info.char_case == SP_FI_UPPER_CASE, info.sign);
-            
-            safe_print_apply_format_info(context, str, info, '0');
-        } break;
+    return length;
+}
+
+#endif // defined(SAFE_PRINT_AVX2)
+
+static sp_s64 safe_print_cstring_length(char const *str) {
+    return safe_print_cstring_length_bounded(str, INT64_MAX);
+}
+
+/*
+ * Returns a pointer to the next {, } or the terminating 0 of the string.
+ * The SIMD versions only use aligned loads, so they never read across a page
+ * boundary past the end of the string.
+ */
+#if defined(SAFE_PRINT_AVX2) && !defined(SAFE_PRINT_SANITIZER)
+
+static char const* safe_print_find_brace(char const *str) {
+    uintptr_t offset = (uintptr_t)str & 31;
+    char const *ptr = str - offset;
+    
+    __m256i opening = _mm256_set1_epi8('{');
+    __m256i closing = _mm256_set1_epi8('}');
+    __m256i zero    = _mm256_setzero_si256();
+    
+    __m256i chunk = _mm256_load_si256((__m256i const*)ptr);
+    sp_u32 mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, opening), _mm256_cmpeq_epi8(chunk, closing)), _mm256_cmpeq_epi8(chunk, zero)));
+    mask &= ~(sp_u32)0 << offset;
+    
+    while (!mask) {
+        ptr += 32;
+        chunk = _mm256_load_si256((__m256i const*)ptr);
+        mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, opening), _mm256_cmpeq_epi8(chunk, closing)), _mm256_cmpeq_epi8(chunk, zero)));
+    }
+    
+    return ptr + safe_print_count_trailing_zeros(mask);
+}
+
+#elif defined(SAFE_PRINT_SSE2) && !defined(SAFE_PRINT_SANITIZER)
+
+static char const* safe_print_find_brace(char const *str) {
+    uintptr_t offset = (uintptr_t)str & 15;
+    char const *ptr = str - offset;
+    
+    __m128i opening = _mm_set1_epi8('{');
+    __m128i closing = _mm_set1_epi8('}');
+    __m128i zero    = _mm_setzero_si128();
+    
+    __m128i chunk = _mm_load_si128((__m128i const*)ptr);
+    sp_u32 mask = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, opening), _mm_cmpeq_epi8(chunk, closing)), _mm_cmpeq_epi8(chunk, zero)));
+    mask &= ~(sp_u32)0 << offset;
+    
+    while (!mask) {
+        ptr += 16;
+        chunk = _mm_load_si128((__m128i const*)ptr);
+        mask = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, opening), _mm_cmpeq_epi8(chunk, closing)), _mm_cmpeq_epi8(chunk, zero)));
+    }
+    
+    return ptr + safe_print_count_trailing_zeros(mask);
+}
+
+#else
+
+static char const* safe_print_find_brace(char const *str) {
+    while (str[0] && str[0] != '{' && str[0] != '}') str += 1;
+    
+    return str;
+}
+
+#endif // defined(SAFE_PRINT_AVX2)
+
+static char safe_print_to_lower(char c) {
+    if (c >= 'A' && c <= 'Z') return c + 32;
+    
+    return c;
+}
+
+static char safe_print_to_upper(char c) {
+    if (c >= 'a' && c <= 'z') return c - 32;
+    
+    return c;
+}
+
+/*
+ * Converts ASCII letters while copying from src to dst. Everything else, including
+ * bytes above 127, is copied unchanged. The SIMD versions handle 32 or 16 bytes at
+ * a time and fall back to the single character functions for the rest.
+ */
+static void safe_print_convert_case(char *dst, char const *src, sp_s64 length, sp_u32 char_case) {
+#if defined(SAFE_PRINT_AVX2) || defined(SAFE_PRINT_SSE2)
+    char first = char_case == SP_FI_UPPER_CASE ? 'a' : 'A';
+    char last  = char_case == SP_FI_UPPER_CASE ? 'z' : 'Z';
+#endif
+    
+#if defined(SAFE_PRINT_AVX2)
+    __m256i lower_bound = _mm256_set1_epi8(first - 1);
+    __m256i upper_bound = _mm256_set1_epi8(last + 1);
+    __m256i case_bit    = _mm256_set1_epi8(0x20);
+    
+    while (length >= 32) {
+        __m256i chunk = _mm256_loadu_si256((__m256i const*)src);
+        __m256i is_letter = _mm256_and_si256(_mm256_cmpgt_epi8(chunk, lower_bound), _mm256_cmpgt_epi8(upper_bound, chunk));
+        _mm256_storeu_si256((__m256i*)dst, _mm256_xor_si256(chunk, _mm256_and_si256(is_letter, case_bit)));
         
-        case SAFE_PRINT_U32: {
-            char buffer[128];
-            SafePrintStringRef str = safe_print_convert_unsigned_to_string(buffer, 128, arg->u32, SAFE_PRINT_BASE(info.base), info.char_case == SP_FI_UPPER_CASE);
-            
-            safe_print_apply_format_info(context, str, info, '0');
-        } break;
+        src += 32;
+        dst += 32;
+        length -= 32;
+    }
+#endif // defined(SAFE_PRINT_AVX2)
+    
+#if defined(SAFE_PRINT_AVX2) || defined(SAFE_PRINT_SSE2)
+    __m128i lower_bound_128 = _mm_set1_epi8(first - 1);
+    __m128i upper_bound_128 = _mm_set1_epi8(last + 1);
+    __m128i case_bit_128    = _mm_set1_epi8(0x20);
+    
+    while (length >= 16) {
+        __m128i chunk = _mm_loadu_si128((__m128i const*)src);
+        __m128i is_letter = _mm_and_si128(_mm_cmpgt_epi8(chunk, lower_bound_128), _mm_cmplt_epi8(chunk, upper_bound_128));
+        _mm_storeu_si128((__m128i*)dst, _mm_xor_si128(chunk, _mm_and_si128(is_letter, case_bit_128)));
         
-        case SAFE_PRINT_I64: {
-            char buffer[128];
-            SafePrintStringRef str = safe_print_convert_signed_to_string(buffer, 128, arg->s64, SAFE_PRINT_BASE(info.base), info.char_case == SP_FI_UPPER_CASE, info.sign);
-            
-            safe_print_apply_format_info(context, str, info, '0');
-        } break;
+        src += 16;
+        dst += 16;
+        length -= 16;
+    }
+#endif // defined(SAFE_PRINT_AVX2) || defined(SAFE_PRINT_SSE2)
+    
+    for (sp_s64 i = 0; i < length; i += 1) {
+        dst[i] = char_case == SP_FI_UPPER_CASE ? safe_print_to_upper(src[i]) : safe_print_to_lower(src[i]);
+    }
+}
+
+static sp_s32 safe_print_compare_string(SafePrintStringRef token, char const *str, sp_s32 length) {
+    if (token.length != length) return sp_false;
+    
+    for (sp_s32 i = 0; i < length; i += 1) {
+        if (token.data[i] != str[i]) return sp_false;
+    }
+    
+    return sp_true;
+}
+
+#if !defined(SAFE_PRINT_USE_OWN_FLOAT_CONVERSION)
+
+static void safe_print_append_buffer(char *buffer, sp_s32 *size, sp_u32 c) {
+    buffer[*size] = c;
+    *size += 1;
+}
+
+#endif
+
+#if !defined(SAFE_PRINT_USE_OWN_INTEGER_CONVERSION) || !defined(SAFE_PRINT_USE_OWN_FLOAT_CONVERSION)
+
+static char SafePrintCharacterLookup[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+static char SafePrintCharacterLookupUppercase[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+// NOTE: From stb_sprintf like the float conversion, shared with the decimal integer conversion.
+static struct
+{
+    short temp; // force next field to be 2-byte aligned
+    char pair[201];
+} stbsp__digitpair =
+{
+    0,
+    "00010203040506070809101112131415161718192021222324"
+        "25262728293031323334353637383940414243444546474849"
+        "50515253545556575859606162636465666768697071727374"
+        "75767778798081828384858687888990919293949596979899"
+};
+
+static sp_s32 safe_print_count_leading_zeros_64(sp_u64 value) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return 63 - index;
+#elif defined(_MSC_VER)
+    unsigned long index;
+    if (value >> 32) {
+        _BitScanReverse(&index, (unsigned long)(value >> 32));
+        return 31 - index;
+    }
+    _BitScanReverse(&index, (unsigned long)value);
+    return 63 - index;
+#else
+    return __builtin_clzll(value);
+#endif
+}
+
+/*
+ * Number of decimal digits without a loop: the highest set bit gives log10 up to one
+ * (1233 / 4096 is about log10(2)), a compare with the next power of 10 corrects it.
+ */
+static sp_s32 safe_print_decimal_digit_count(sp_u64 number) {
+    static sp_u64 const powers_of_10[] = {
+        1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL,
+        10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+        1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL,
+    };
+    
+    // NOTE: Setting the lowest bit never crosses a power of 10 but makes 0 count as one digit.
+    number |= 1;
+    sp_s32 log10 = ((64 - safe_print_count_leading_zeros_64(number)) * 1233) >> 12;
+    
+    return log10 + (number >= powers_of_10[log10]);
+}
+
+/*
+ * Writes the decimal digits of number backwards, so the last digit ends up in front of end,
+ * and returns the first digit. Everything above 8 digits is split off in 32 bit chunks like
+ * stbsp__real_to_str does, the chunks are converted two digits at a time with stbsp__digitpair.
+ * Needs space for 20 characters.
+ */
+static char* safe_print_convert_decimal(char *end, sp_u64 number) {
+    char *ptr = end;
+    
+    while (number >= 100000000) {
+        sp_u32 chunk = (sp_u32)(number % 100000000);
+        number /= 100000000;
         
-        case SAFE_PRINT_U64: {
-            char buffer[128];
-            SafePrintStringRef str = safe_print_convert_unsigned_to_string(buffer, 128, arg->u64, SAFE_PRINT_BASE(info.base), info.char_case == SP_FI_UPPER_CASE);
-            
-            safe_print_apply_format_info(context, str, info, '0');
-        } break;
+        for (sp_s32 i = 0; i < 4; i += 1) {
+            ptr -= 2;
+            memcpy(ptr, &stbsp__digitpair.pair[(chunk % 100) * 2], 2);
+            chunk /= 100;
+        }
+    }
+    
+    sp_u32 chunk = (sp_u32)number;
+    while (chunk >= 100) {
+        ptr -= 2;
+        memcpy(ptr, &stbsp__digitpair.pair[(chunk % 100) * 2], 2);
+        chunk /= 100;
+    }
+    
+    if (chunk >= 10) {
+        ptr -= 2;
+        memcpy(ptr, &stbsp__digitpair.pair[chunk * 2], 2);
+    } else {
+        ptr -= 1;
+        ptr[0] = (char)('0' + chunk);
+    }
+    
+    return ptr;
+}
+
+#endif
+
+#if defined(SAFE_PRINT_USE_OWN_INTEGER_CONVERSION)
+
+static SafePrintStringRef safe_print_convert_signed_to_string(char *buffer, sp_s32 size, sp_s64 signed_number, sp_s32 base, sp_s32 uppercase, sp_b32 keep_sign);
+static SafePrintStringRef safe_print_convert_unsigned_to_string(char *buffer, sp_s32 size, sp_u64 number, sp_s32 base, sp_s32 uppercase);
+
+#else
+
+/*
+ * Writes the digits of number in base 2, 8 or 16 backwards like safe_print_convert_decimal.
+ * The digit count comes from the highest set bit, every digit is a shift and a mask.
+ * Hex numbers are converted 16 digits at once with SSE2: the nibbles are spread into bytes
+ * and moved to '0' or 'a' depending on whether they are above 9. Needs space for 64 characters.
+ */
+static char* safe_print_convert_power_of_two(char *end, sp_u64 number, sp_s32 shift, sp_s32 uppercase) {
+    sp_s32 bits = 64 - safe_print_count_leading_zeros_64(number | 1);
+    sp_s32 digits = (bits + shift - 1) / shift;
+    
+#if defined(SAFE_PRINT_AVX2) || defined(SAFE_PRINT_SSE2)
+    if (shift == 4) {
+        char bytes[16];
+        for (sp_s32 i = 0; i < 8; i += 1) {
+            bytes[i] = (char)(number >> (56 - i * 8));
+        }
         
-        case SAFE_PRINT_R64: {
-            char buffer[512];
-            SafePrintStringRef str = safe_print_convert_double_to_string(buffer, 512, arg->r64, info.precision ? info.precision : 6, info.scientific, info.base == 16 ? sp_true : sp_false, info.char_case == SP_FI_UPPER_CASE, info.sign);
-            
-            safe_print_apply_format_info(context, str, info, '0');
-        } break;
+        __m128i low_bits = _mm_set1_epi8(0x0F);
+        __m128i packed   = _mm_loadl_epi64((__m128i const*)bytes);
+        __m128i nibbles  = _mm_unpacklo_epi8(_mm_and_si128(_mm_srli_epi16(packed, 4), low_bits), _mm_and_si128(packed, low_bits));
+        __m128i letters  = _mm_and_si128(_mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)), _mm_set1_epi8((uppercase ? 'A' : 'a') - '0' - 10));
+        _mm_storeu_si128((__m128i*)bytes, _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), letters));
+        
+        memcpy(end - digits, bytes + 16 - digits, digits);
+        return end - digits;
+    }
+#endif
+    
+    char *lookup = uppercase ? SafePrintCharacterLookupUppercase : SafePrintCharacterLookup;
+    sp_u64 mask = ((sp_u64)1 << shift) - 1;
+    
+    char *ptr = end;
+    for (sp_s32 i = 0; i < digits; i += 1) {
+        ptr -= 1;
+        ptr[0] = lookup[number & mask];
+        number >>= shift;
+    }
+    
+    return ptr;
+}
+
+static sp_s32 safe_print_power_of_two_shift(sp_s32 base) {
+    switch (base) {
+        case 2:  return 1;
+        case 8:  return 3;
+        case 16: return 4;
+        default: return 0;
+    }
+}
+
+static SafePrintStringRef safe_print_convert_signed_to_string(char *buffer, sp_s32 size, sp_s64 signed_number, sp_s32 base, sp_s32 uppercase, sp_b32 keep_sign) {
+    sp_s32 is_negative;
+    sp_u64 number;
+    
+    if (signed_number < 0) {
+        is_negative = 1;
+        // NOTE: Negate as unsigned, -INT64_MIN doesn't fit into a sp_s64.
+        number = (sp_u64)0 - (sp_u64)signed_number;
+    } else {
+        is_negative = 0;
+        number = signed_number;
+    }
+    
+    sp_s32 shift = safe_print_power_of_two_shift(base);
+    if ((base == 10 && size > 20) || (shift && size > 64)) {
+        char *ptr = shift ? safe_print_convert_power_of_two(buffer + size, number, shift, uppercase) : safe_print_convert_decimal(buffer + size, number);
+        if (is_negative || keep_sign) {
+            ptr -= 1;
+            ptr[0] = is_negative ? '-' : '+';
+        }
+        
+        SafePrintStringRef result = {ptr, (int)(buffer + size - ptr)};
+        return result;
+    }
+    
+    char *lookup = uppercase ? SafePrintCharacterLookupUppercase : SafePrintCharacterLookup;
+    
+    char *ptr = buffer + (size - 1);
+    sp_s32 written = 0;
+    do {
+        sp_s64 quot = number / base;
+        sp_s64 rem  = number % base;
+        
+        *ptr = lookup[rem];
+        ptr -= 1;
+        written += 1;
+        number = quot;
+    } while (number && written < size);
+    
+    if (is_negative || keep_sign) {
+        ptr[0] = is_negative ? '-' : '+';
+        written += 1;
+    } else {
+        ptr += 1;
+    }
+    
+    SafePrintStringRef result = {ptr, written};
+    return result;
+}
+
+static SafePrintStringRef safe_print_convert_unsigned_to_string(char *buffer, sp_s32 size, sp_u64 number, sp_s32 base, sp_s32 uppercase) {
+    sp_s32 shift = safe_print_power_of_two_shift(base);
+    if ((base == 10 && size >= 20) || (shift && size >= 64)) {
+        char *ptr = shift ? safe_print_convert_power_of_two(buffer + size, number, shift, uppercase) : safe_print_convert_decimal(buffer + size, number);
+        
+        SafePrintStringRef result = {ptr, (int)(buffer + size - ptr)};
+        return result;
+    }
+    
+    char *lookup = uppercase ? SafePrintCharacterLookupUppercase : SafePrintCharacterLookup;
+    
+    char *ptr = buffer + size;
+    sp_s32 written = 0;
+    do {
+        sp_u64 quot = number / base;
+        sp_u64 rem  = number % base;
+        
+        ptr -= 1;
+        *ptr = lookup[rem];
+        written += 1;
+        number = quot;
+    } while (number && written < size);
+    
+    SafePrintStringRef result = {ptr, written};
+    return result;
+}
+
+#endif // defined(SAFE_PRINT_USE_OWN_INTEGER_CONVERSION)
+
+#if defined(SAFE_PRINT_USE_OWN_FLOAT_CONVERSION)
+
+static SafePrintStringRef safe_print_convert_double_to_string(char *buffer, sp_s32 size, sp_r64 number, sp_s32 precision, sp_b32 scientific, sp_b32 hex, sp_b32 uppercase, sp_b32 keep_sign);
+
+// NOTE: Floats are printed through the double conversion.
+#define safe_print_convert_float_to_string safe_print_convert_double_to_string
+
+#else
+
+// Using STB's float conversion for simplicity. For a more elaborate explanation, see the end of the file.
+
+#define stbsp__uint32 unsigned int
+#define stbsp__int32 signed int
+
+#ifdef _MSC_VER
+#define stbsp__uint64 unsigned __int64
+#define stbsp__int64 signed __int64
+#else
+#define stbsp__uint64 unsigned long long
+#define stbsp__int64 signed long long
+#endif
+
+#define stbsp__uint16 unsigned short
+
+#define STBSP__SPECIAL 0x7000
+
+
+static stbsp__int32 stbsp__real_to_str(char const **start, stbsp__uint32 *len, char *out, stbsp__int32 *decimal_pos, double value, stbsp__uint32 frac_digits);
+static stbsp__int32 stbsp__real_to_parts(stbsp__int64 *bits, stbsp__int32 *expo, double value);
+
+static void safe_print_double_to_decimal(sp_u64 ieee_mantissa, sp_u32 ieee_exponent, sp_u64 *digits, sp_s32 *exponent);
+static void safe_print_float_to_decimal(sp_u32 ieee_mantissa, sp_u32 ieee_exponent, sp_u32 *digits, sp_s32 *exponent);
+
+/*
+ * Prints output * 10^exponent, the result of the shortest conversions, or the special value if it is set.
+ * Numbers from 1e-6 up to 1e21 use the fixed notation, everything else and sci the scientific one,
+ * without trailing zeros in both.
+ */
+static SafePrintStringRef safe_print_convert_shortest_to_string(char *buffer, sp_b32 negative, char const *special, sp_u64 output, sp_s32 exponent, sp_b32 scientific, sp_b32 uppercase, sp_b32 keep_sign) {
+    sp_s32 written = 0;
+    if (negative) safe_print_append_buffer(buffer, &written, '-');
+    else if (keep_sign) safe_print_append_buffer(buffer, &written, '+');
+    
+    if (special) {
+        for (sp_s32 i = 0; i < 3; i += 1) {
+            safe_print_append_buffer(buffer, &written, special[i]);
+        }
+        
+        return (SafePrintStringRef){buffer, written};
+    }
+    
+    char digit_buffer[20];
+    char *digits = safe_print_convert_decimal(digit_buffer + 20, output);
+    sp_s32 length = (sp_s32)(digit_buffer + 20 - digits);
+    sp_s32 point = exponent + length;
+    
+    if (!scientific && point > -6 && point <= 21) {
+        if (point <= 0) {
+            safe_print_append_buffer(buffer, &written, '0');
+            safe_print_append_buffer(buffer, &written, '.');
+            for (sp_s32 i = point; i < 0; i += 1) {
+                safe_print_append_buffer(buffer, &written, '0');
+            }
+            for (sp_s32 i = 0; i < length; i += 1) {
+                safe_print_append_buffer(buffer, &written, digits[i]);
+            }
+        } else {
+            for (sp_s32 i = 0; i < point; i += 1) {
+                safe_print_append_buffer(buffer, &written, i < length ? digits[i] : '0');
+            }
+            if (length > point) {
+                safe_print_append_buffer(buffer, &written, '.');
+                for (sp_s32 i = point; i < length; i += 1) {
+                    safe_print_append_buffer(buffer, &written, digits[i]);
+                }
+            }
+        }
+    } else {
+        safe_print_append_buffer(buffer, &written, digits[0]);
+        if (length > 1) {
+            safe_print_append_buffer(buffer, &written, '.');
+            for (sp_s32 i = 1; i < length; i += 1) {
+                safe_print_append_buffer(buffer, &written, digits[i]);
+            }
+        }
+        safe_print_append_buffer(buffer, &written, uppercase ? 'E' : 'e');
+        
+        char exp_buffer[8];
+        SafePrintStringRef exp_str = safe_print_convert_signed_to_string(exp_buffer, 8, point - 1, 10, 0, sp_true);
+        for (sp_s32 i = 0; i < exp_str.length; i += 1) {
+            safe_print_append_buffer(buffer, &written, exp_str.data[i]);
+        }
+    }
+    
+    return (SafePrintStringRef){buffer, written};
+}
+
+// NOTE: The fewest digits that read back as the same double.
+static SafePrintStringRef safe_print_convert_double_to_shortest(char *buffer, sp_r64 number, sp_b32 scientific, sp_b32 uppercase, sp_b32 keep_sign) {
+    sp_u64 bits;
+    memcpy(&bits, &number, sizeof(bits));
+    
+    sp_u64 ieee_mantissa = bits & (((sp_u64)1 << 52) - 1);
+    sp_u32 ieee_exponent = (sp_u32)(bits >> 52) & 0x7FF;
+    
+    sp_u64 output = 0;
+    sp_s32 exponent = 0;
+    char const *special = 0;
+    if (ieee_exponent == 0x7FF) {
+        special = ieee_mantissa ? "NaN" : "Inf";
+    } else if (ieee_exponent || ieee_mantissa) {
+        safe_print_double_to_decimal(ieee_mantissa, ieee_exponent, &output, &exponent);
+    }
+    
+    return safe_print_convert_shortest_to_string(buffer, (sp_b32)(bits >> 63), special, output, exponent, scientific, uppercase, keep_sign);
+}
+
+/*
+ * A precision of 0 prints the shortest representation, except for hex floats which then use 6 digits.
+ * The precision is limited so that the 309 integer digits of DBL_MAX, the sign, the point and
+ * the fraction still fit into the buffer.
+ */
+static SafePrintStringRef safe_print_convert_double_to_string(char *buffer, sp_s32 size, sp_r64 number, sp_s32 precision, sp_b32 scientific, sp_b32 hex, sp_b32 uppercase, sp_b32 keep_sign) {
+    if (!precision) {
+        if (!hex) return safe_print_convert_double_to_shortest(buffer, number, scientific, uppercase, keep_sign);
+        precision = 6;
+    }
+    if (precision > size - 320) precision = size - 320;
+    
+    stbsp__int32 pos;
+    char const *out;
+    char tmp[512];
+    stbsp__uint32 tmp_size = 512;
+    
+    char *lookup = uppercase ? SafePrintCharacterLookupUppercase : SafePrintCharacterLookup;
+    
+    stbsp__int32 sign = stbsp__real_to_str(&out, &tmp_size, tmp, &pos, number, precision);
+    
+    sp_s32 written = 0;
+    if (sign) safe_print_append_buffer(buffer, &written, '-');
+    else if (keep_sign) safe_print_append_buffer(buffer, &written, '+');
+    
+    if (pos == STBSP__SPECIAL) {
+        safe_print_append_buffer(buffer, &written, out[0]);
+        safe_print_append_buffer(buffer, &written, out[1]);
+        safe_print_append_buffer(buffer, &written, out[2]);
+        
+        return (SafePrintStringRef){buffer, written};
+    }
+    
+    if (hex) {
+        stbsp__uint64 bits;
+        stbsp__int32 expo;
+        sign = stbsp__real_to_parts((stbsp__int64*)&bits, &expo, number);
+        
+        if (expo == -1023)
+            expo = bits ? -1022 : 0;
+        else
+            bits |= ((stbsp__uint64)1) << 52;
+        
+        bits <<= 64 - 56;
+        if (precision < 15)
+            bits += (((stbsp__uint64)8) << 56) >> (precision * 4);
+        
+        safe_print_append_buffer(buffer, &written, '0');
+        safe_print_append_buffer(buffer, &written, 'x');
+        
+        safe_print_append_buffer(buffer, &written, lookup[(bits >> 60) & 15]);
+        safe_print_append_buffer(buffer, &written, '.');
+        
+        bits <<= 4;
+        while (precision) {
+            safe_print_append_buffer(buffer, &written, lookup[(bits >> 60) & 15]);
+            bits <<= 4;
+            precision -= 1;
+        }
+        safe_print_append_buffer(buffer, &written, uppercase ? 'P' : 'p');
+        
+        char exp_buffer[8];
+        SafePrintStringRef exp_str = safe_print_convert_signed_to_string(exp_buffer, 8, expo, 10, uppercase, sp_true);
+        
+        for (sp_s32 i = 0; i < exp_str.length; i += 1) {
+            safe_print_append_buffer(buffer, &written, exp_str.data[i]);
+        }
+    } else if (scientific) {
+        sp_s32 exp = pos - 1;
+        char exp_buffer[8];
+        SafePrintStringRef exp_str = safe_print_convert_signed_to_string(exp_buffer, 8, exp, 10, 0, sp_true);
+        
+        safe_print_append_buffer(buffer, &written, out[0]);
+        tmp_size -= 1;
+        out += 1;
+        
+        safe_print_append_buffer(buffer, &written, '.');
+        while (tmp_size && precision) {
+            safe_print_append_buffer(buffer, &written, out[0]);
+            out += 1;
+            tmp_size -= 1;
+            precision -= 1;
+        }
+        while (precision) {
+            safe_print_append_buffer(buffer, &written, '0');
+            precision -= 1;
+        }
+        safe_print_append_buffer(buffer, &written, uppercase ? 'E' : 'e');
+        for (sp_s32 i = 0; i < exp_str.length; i += 1) {
+            safe_print_append_buffer(buffer, &written, exp_str.data[i]);
+        }
+    } else {
+        if (pos == 0) {
+            safe_print_append_buffer(buffer, &written, '0');
+            safe_print_append_buffer(buffer, &written, '.');
+        } else if (pos > 0) {
+            while (pos && tmp_size) {
+                safe_print_append_buffer(buffer, &written, out[0]);
+                out += 1;
+                tmp_size -= 1;
+                pos -= 1;
+            }
+            while (pos) {
+                safe_print_append_buffer(buffer, &written, '0');
+                pos -= 1;
+            }
+            safe_print_append_buffer(buffer, &written, '.');
+        } else {
+            safe_print_append_buffer(buffer, &written, '0');
+            safe_print_append_buffer(buffer, &written, '.');
+            
+            while (pos < 0 && precision) {
+                safe_print_append_buffer(buffer, &written, '0');
+                pos += 1;
+                precision -= 1;
+            }
+        }
+        
+        while (precision && tmp_size) {
+            safe_print_append_buffer(buffer, &written, out[0]);
+            out += 1;
+            tmp_size -= 1;
+            precision -= 1;
+        }
+        
+        while (precision) {
+            safe_print_append_buffer(buffer, &written, '0');
+            precision -= 1;
+        }
+    }
+    
+    return (SafePrintStringRef){buffer, written};
+}
+
+/*
+ * Floats get their own shortest conversion, a float widened to a double would print the digits of
+ * the double closest to it (e.g. 0.1f as 0.10000000149011612). Everything else uses the double conversion.
+ */
+static SafePrintStringRef safe_print_convert_float_to_string(char *buffer, sp_s32 size, sp_r32 number, sp_s32 precision, sp_b32 scientific, sp_b32 hex, sp_b32 uppercase, sp_b32 keep_sign) {
+    if (precision || hex) return safe_print_convert_double_to_string(buffer, size, number, precision, scientific, hex, uppercase, keep_sign);
+    
+    sp_u32 bits;
+    memcpy(&bits, &number, sizeof(bits));
+    
+    sp_u32 ieee_mantissa = bits & ((1u << 23) - 1);
+    sp_u32 ieee_exponent = (bits >> 23) & 0xFF;
+    
+    sp_u32 output = 0;
+    sp_s32 exponent = 0;
+    char const *special = 0;
+    if (ieee_exponent == 0xFF) {
+        special = ieee_mantissa ? "NaN" : "Inf";
+    } else if (ieee_exponent || ieee_mantissa) {
+        safe_print_float_to_decimal(ieee_mantissa, ieee_exponent, &output, &exponent);
+    }
+    
+    return safe_print_convert_shortest_to_string(buffer, (sp_b32)(bits >> 31), special, output, exponent, scientific, uppercase, keep_sign);
+}
+
+#endif // defined(SAFE_PRINT_USE_OWN_FLOAT_CONVERSION)
+
+#if defined(SAFE_PRINT_USE_OWN_FILE_OUTPUT)
+
+static void safe_print_output_string(SafePrintContext *context, char const *str, size_t length);
+
+#elif defined(SAFE_PRINT_USE_FD_OUTPUT)
+
+static void safe_print_output_string(SafePrintContext *context, char const *str, size_t length) {
+    while (length) {
+        ssize_t written = write(context->file, str, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            
+            context->error = sp_true;
+            return;
+        }
+        
+        context->written += written;
+        str += written;
+        length -= written;
+    }
+}
+
+static void safe_print_output_segments(SafePrintContext *context, struct iovec *segments, int count) {
+    while (count) {
+        ssize_t written = writev(context->file, segments, count);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            
+            context->error = sp_true;
+            return;
+        }
+        
+        context->written += written;
+        
+        // NOTE: On a partial write skip everything that made it and try again with the rest.
+        while (count && (size_t)written >= segments->iov_len) {
+            written -= segments->iov_len;
+            segments += 1;
+            count -= 1;
+        }
+        if (count) {
+            segments->iov_base = (char*)segments->iov_base + written;
+            segments->iov_len -= written;
+        }
+    }
+}
+
+static void safe_print_close_segment(SafePrintContext *context) {
+    if (context->buffer_used > context->segment_start) {
+        context->segments[context->segment_count].iov_base = context->buffer + context->segment_start;
+        context->segments[context->segment_count].iov_len  = context->buffer_used - context->segment_start;
+        context->segment_count += 1;
+    }
+    context->segment_start = context->buffer_used;
+}
+
+#else
+
+static void safe_print_output_string(SafePrintContext *context, char const *str, size_t length) {
+    size_t written = fwrite(str, 1, length, context->file);
+    context->written += written;
+    if (written != length) {
+        context->error = sp_true;
+    }
+}
+
+#endif // defined(SAFE_PRINT_USE_OWN_FILE_OUTPUT)
+
+#if defined(SAFE_PRINT_THREAD_BUFFER_SIZE)
+
+/*
+ * Thread buffer:
+ *
+ * The staging buffer of a call still does the formatting, the thread buffer only decides
+ * when the bytes reach safe_print_output_string. A thread has a slot per file it prints
+ * to, up to SAFE_PRINT_THREAD_BUFFER_FILES of them, so output that alternates between a
+ * few files is still collected per file. Only a new file when all slots are taken writes
+ * one of the others out, its failure is kept for the next safe_print_flush.
+ */
+typedef struct SafePrintThreadBufferSlot {
+    SafePrintFileType file;
+    sp_s32 used;
+    char data[SAFE_PRINT_THREAD_BUFFER_SIZE];
+} SafePrintThreadBufferSlot;
+
+typedef struct SafePrintThreadBuffer {
+    sp_s32 policy;
+    sp_b32 registered;
+    sp_b32 failed;
+    sp_s32 next_victim;
+    SafePrintThreadBufferSlot slots[SAFE_PRINT_THREAD_BUFFER_FILES];
+} SafePrintThreadBuffer;
+
+static SAFE_PRINT_THREAD_LOCAL SafePrintThreadBuffer SafePrintThreadOutput;
+static once_flag SafePrintThreadExitOnce = ONCE_FLAG_INIT;
+static tss_t SafePrintThreadExitKey;
+
+static sp_b32 safe_print_write_thread_buffer(SafePrintThreadBufferSlot *slot) {
+    SafePrintContext context = {0};
+    context.file = slot->file;
+    context.target = SP_TARGET_FILE;
+    
+    if (slot->used) {
+        safe_print_output_string(&context, slot->data, slot->used);
+        slot->used = 0;
+    }
+    
+    return !context.error;
+}
+
+static sp_b32 safe_print_write_thread_buffers(SafePrintThreadBuffer *thread_buffer) {
+    sp_b32 success = !thread_buffer->failed;
+    thread_buffer->failed = sp_false;
+    
+    for (sp_s32 i = 0; i < SAFE_PRINT_THREAD_BUFFER_FILES; i += 1) {
+        if (!safe_print_write_thread_buffer(&thread_buffer->slots[i])) success = sp_false;
+    }
+    
+    return success;
+}
+
+static void safe_print_thread_exit(void *data) {
+    safe_print_write_thread_buffers((SafePrintThreadBuffer*)data);
+}
+
+static void safe_print_process_exit(void) {
+    safe_print_write_thread_buffers(&SafePrintThreadOutput);
+}
+
+static void safe_print_register_thread_exit(void) {
+    tss_create(&SafePrintThreadExitKey, safe_print_thread_exit);
+    
+    // NOTE: The thread calling exit does not run its tss destructors.
+    atexit(safe_print_process_exit);
+}
+
+static SafePrintThreadBufferSlot* safe_print_thread_buffer_slot(SafePrintThreadBuffer *thread_buffer, SafePrintFileType file) {
+    SafePrintThreadBufferSlot *free_slot = 0;
+    
+    // NOTE: The file type can be anything with SAFE_PRINT_USE_OWN_FILE_OUTPUT, so it is compared by its bytes.
+    for (sp_s32 i = 0; i < SAFE_PRINT_THREAD_BUFFER_FILES; i += 1) {
+        SafePrintThreadBufferSlot *slot = &thread_buffer->slots[i];
+        if (!slot->used) {
+            if (!free_slot) free_slot = slot;
+        } else if (!memcmp(&slot->file, &file, sizeof(SafePrintFileType))) {
+            return slot;
+        }
+    }
+    
+    if (!free_slot) {
+        free_slot = &thread_buffer->slots[thread_buffer->next_victim];
+        thread_buffer->next_victim = (thread_buffer->next_victim + 1) % SAFE_PRINT_THREAD_BUFFER_FILES;
+        if (!safe_print_write_thread_buffer(free_slot)) thread_buffer->failed = sp_true;
+    }
+    free_slot->file = file;
+    
+    return free_slot;
+}
+
+static void safe_print_write_output(SafePrintContext *context, char const *str, size_t length) {
+    SafePrintThreadBuffer *thread_buffer = &SafePrintThreadOutput;
+    
+    if (!thread_buffer->registered) {
+        call_once(&SafePrintThreadExitOnce, safe_print_register_thread_exit);
+        tss_set(SafePrintThreadExitKey, thread_buffer);
+        thread_buffer->registered = sp_true;
+    }
+    
+    SafePrintThreadBufferSlot *slot = safe_print_thread_buffer_slot(thread_buffer, context->file);
+    
+    if (slot->used + length > SAFE_PRINT_THREAD_BUFFER_SIZE) {
+        if (!safe_print_write_thread_buffer(slot)) context->error = sp_true;
+        
+        if (length > SAFE_PRINT_THREAD_BUFFER_SIZE) {
+            safe_print_output_string(context, str, length);
+            return;
+        }
+    }
+    
+    memcpy(slot->data + slot->used, str, length);
+    slot->used += (sp_s32)length;
+    context->written += (sp_s32)length;
+    
+    if (thread_buffer->policy == SAFE_PRINT_FLUSH_LINE && memchr(str, '\n', length)) {
+        if (!safe_print_write_thread_buffer(slot)) context->error = sp_true;
+    }
+}
+
+void safe_print_flush_policy(int policy) {
+    SafePrintThreadOutput.policy = policy;
+}
+
+int safe_print_flush(void) {
+    return safe_print_write_thread_buffers(&SafePrintThreadOutput) ? 0 : 1;
+}
+
+#else
+#define safe_print_write_output safe_print_output_string
+#endif // defined(SAFE_PRINT_THREAD_BUFFER_SIZE)
+
+/*
+ * Every sink gets the same bytes, the call reports them once. A failing sink must not set
+ * context->error, that would stop the formatting for all of them. It gets nothing more
+ * of this call instead and the call reports the failure at the end, see
+ * safe_print_sinks_implementation.
+ */
+static void safe_print_output_sinks(SafePrintContext *context, char const *str, size_t length) {
+    sp_s32 written = context->written;
+    sp_s32 error = context->error;
+    
+    for (sp_s32 i = 0; i < context->sink_count; i += 1) {
+        SafePrintSink const *sink = &context->sinks[i];
+        sp_u64 bit = (sp_u64)1 << i;
+        if (context->failed_sinks & bit) continue;
+        
+        sp_b32 failed;
+        if (sink->write) {
+            failed = sink->write(sink->user, str, length) != 0;
+        } else {
+            context->file = sink->file;
+            context->error = 0;
+            safe_print_write_output(context, str, length);
+            failed = context->error != 0;
+        }
+        
+        if (failed) context->failed_sinks |= bit;
+    }
+    
+    context->error = error;
+    context->written = written + (sp_s32)length;
+}
+
+
+/*
+ * A memory target can't be flushed. Everything that does not fit is only counted
+ * so safe_print_buffer can report the needed size like snprintf does.
+ */
+static void safe_print_flush_buffer(SafePrintContext *context) {
+    if (context->target == SP_TARGET_MEMORY) {
+        context->written = (sp_s32)(context->buffer_used + context->overflow);
+        return;
+    }
+    
+    if (context->target == SP_TARGET_SINKS) {
+        if (context->buffer_used) {
+            safe_print_output_sinks(context, context->buffer, context->buffer_used);
+            context->buffer_used = 0;
+        }
+        return;
+    }
+    
+#if defined(SAFE_PRINT_USE_FD_OUTPUT) && !defined(SAFE_PRINT_THREAD_BUFFER_SIZE)
+    safe_print_close_segment(context);
+    safe_print_output_segments(context, context->segments, context->segment_count);
+    context->segment_count = 0;
+    context->segment_start = 0;
+    context->buffer_used = 0;
+#else
+    if (context->buffer_used) {
+        safe_print_write_output(context, context->buffer, context->buffer_used);
+        context->buffer_used = 0;
+    }
+#endif // defined(SAFE_PRINT_USE_FD_OUTPUT) && !defined(SAFE_PRINT_THREAD_BUFFER_SIZE)
+}
+
+static void safe_print_push_character(SafePrintContext *context, char c) {
+    if (context->buffer_used == context->buffer_size) {
+        safe_print_flush_buffer(context);
+        
+        if (context->buffer_used == context->buffer_size) {
+            context->overflow += 1;
+            return;
+        }
+    }
+    
+    context->buffer[context->buffer_used] = c;
+    context->buffer_used += 1;
+}
+
+static void safe_print_push_string(SafePrintContext *context, char const *str, sp_s64 length) {
+    if (context->buffer_used + length > context->buffer_size) {
+        safe_print_flush_buffer(context);
+        
+        if (context->buffer_used + length > context->buffer_size) {
+            if (context->target == SP_TARGET_MEMORY) {
+                sp_s64 space = context->buffer_size - context->buffer_used;
+                if (space > 0) memcpy(context->buffer + context->buffer_used, str, space);
+                context->buffer_used += space;
+                context->overflow += length - space;
+            } else if (context->target == SP_TARGET_SINKS) {
+                safe_print_output_sinks(context, str, length);
+            } else {
+                // NOTE: Strings that would not fit anyway are passed through without copying them first.
+                safe_print_write_output(context, str, length);
+            }
+            
+            return;
+        }
+    }
+    
+    memcpy(context->buffer + context->buffer_used, str, length);
+    context->buffer_used += length;
+}
+
+/*
+ * Like safe_print_push_string, but the memory has to stay valid until the end of the
+ * call. With SAFE_PRINT_USE_FD_OUTPUT longer strings are written straight from their
+ * place with writev instead of being copied to the staging buffer first.
+ */
+static void safe_print_push_reference(SafePrintContext *context, char const *str, sp_s64 length) {
+#if defined(SAFE_PRINT_USE_FD_OUTPUT) && !defined(SAFE_PRINT_THREAD_BUFFER_SIZE)
+    if (context->target == SP_TARGET_FILE && length >= SAFE_PRINT_MIN_REFERENCE_SIZE) {
+        // NOTE: Room is needed for the pending part of the staging buffer, the reference itself
+        //       and whatever ends up in the staging buffer after it.
+        if (context->segment_count + 3 > SAFE_PRINT_MAX_SEGMENTS) safe_print_flush_buffer(context);
+        
+        safe_print_close_segment(context);
+        context->segments[context->segment_count].iov_base = (void*)str;
+        context->segments[context->segment_count].iov_len  = length;
+        context->segment_count += 1;
+        
+        return;
+    }
+#endif // defined(SAFE_PRINT_USE_FD_OUTPUT) && !defined(SAFE_PRINT_THREAD_BUFFER_SIZE)
+    
+    safe_print_push_string(context, str, length);
+}
+
+static void safe_print_push_string_with_case(SafePrintContext *context, char const *str, sp_s64 length, sp_u32 char_case) {
+    while (length) {
+        if (context->buffer_used == context->buffer_size) {
+            safe_print_flush_buffer(context);
+            
+            if (context->buffer_used == context->buffer_size) {
+                context->overflow += length;
+                return;
+            }
+        }
+        
+        sp_s64 space = context->buffer_size - context->buffer_used;
+        sp_s64 chunk = length < space ? length : space;
+        
+        safe_print_convert_case(context->buffer + context->buffer_used, str, chunk, char_case);
+        context->buffer_used += chunk;
+        str += chunk;
+        length -= chunk;
+    }
+}
+
+static void safe_print_push_fill(SafePrintContext *context, char c, sp_s64 count) {
+    while (count) {
+        if (context->buffer_used == context->buffer_size) {
+            safe_print_flush_buffer(context);
+            
+            if (context->buffer_used == context->buffer_size) {
+                context->overflow += count;
+                return;
+            }
+        }
+        
+        sp_s64 space  = context->buffer_size - context->buffer_used;
+        sp_s64 length = count < space ? count : space;
+        
+        memset(context->buffer + context->buffer_used, c, length);
+        context->buffer_used += length;
+        count -= length;
+    }
+}
+
+
+static void safe_print_apply_format_info(SafePrintContext *context, SafePrintStringRef str, SafePrintFormatInfo info, char default_fill) {
+    sp_s32 space = 0;
+    if (str.length < info.min) {
+        space = info.min - str.length;
+    }
+    if (info.max && str.length > info.max)
+        str.length = info.max;
+    
+    sp_s32 align = info.alignment ? info.alignment : SP_FI_ALIGN_RIGHT;
+    if (align == SP_FI_ALIGN_RIGHT) {
+        safe_print_push_fill(context, info.fill ? info.fill : default_fill, space);
+    }
+    safe_print_push_string(context, str.data, str.length);
+    if (align == SP_FI_ALIGN_LEFT) {
+        safe_print_push_fill(context, info.fill ? info.fill : default_fill, space);
+    }
+}
+
+#if !defined(SAFE_PRINT_USE_OWN_INTEGER_CONVERSION)
+
+/*
+ * Prints an integer like converting it to a string and passing it to safe_print_apply_format_info,
+ * but the length is known up front, so the digits are written straight into the output buffer.
+ * Returns false for the cases that still take that way: bases other than 2, 8, 10 and 16 and
+ * numbers cut off by max.
+ */
+static sp_b32 safe_print_push_integer(SafePrintContext *context, SafePrintFormatInfo info, sp_u64 number, sp_b32 is_negative, sp_b32 keep_sign) {
+    sp_s32 base  = SAFE_PRINT_BASE(info.base);
+    sp_s32 shift = safe_print_power_of_two_shift(base);
+    if (base != 10 && !shift) return sp_false;
+    
+    sp_s32 digits;
+    if (shift) {
+        digits = (64 - safe_print_count_leading_zeros_64(number | 1) + shift - 1) / shift;
+    } else {
+        digits = safe_print_decimal_digit_count(number);
+    }
+    
+    sp_s32 has_sign = is_negative || keep_sign;
+    sp_s32 length = digits + has_sign;
+    if (info.max && length > info.max) return sp_false;
+    
+    sp_s32 space = length < info.min ? info.min - length : 0;
+    char fill = info.fill ? info.fill : '0';
+    
+    sp_s32 align = info.alignment ? info.alignment : SP_FI_ALIGN_RIGHT;
+    if (align == SP_FI_ALIGN_RIGHT) {
+        safe_print_push_fill(context, fill, space);
+    }
+    
+    if (context->buffer_size - context->buffer_used < length) safe_print_flush_buffer(context);
+    
+    // NOTE: Only a full caller buffer has no room after the flush, the number is then cut off like any other string.
+    char fallback[72];
+    sp_b32 in_place = context->buffer_size - context->buffer_used >= length;
+    char *end = (in_place ? context->buffer + context->buffer_used : fallback) + length;
+    
+    char *start;
+    if (shift) {
+        start = safe_print_convert_power_of_two(end, number, shift, info.char_case == SP_FI_UPPER_CASE);
+    } else {
+        start = safe_print_convert_decimal(end, number);
+    }
+    if (has_sign) start[-1] = is_negative ? '-' : '+';
+    
+    if (in_place) {
+        context->buffer_used += length;
+    } else {
+        safe_print_push_string(context, fallback, length);
+    }
+    
+    if (align == SP_FI_ALIGN_LEFT) {
+        safe_print_push_fill(context, fill, space);
+    }
+    
+    return sp_true;
+}
+
+#else
+
+#define safe_print_push_integer(context, info, number, is_negative, keep_sign) sp_false
+
+#endif // !defined(SAFE_PRINT_USE_OWN_INTEGER_CONVERSION)
+
+static void safe_print_apply_format_info_to_string(SafePrintContext *context, SafePrintStringRef str, SafePrintFormatInfo info, char default_fill) {
+    sp_s32 space = 0;
+    if (str.length < info.min) {
+        space = info.min - str.length;
+    }
+    if (info.max && str.length > info.max)
+        str.length = info.max;
+    
+    sp_s32 align = info.alignment ? info.alignment : SP_FI_ALIGN_LEFT;
+    if (align == SP_FI_ALIGN_RIGHT) {
+        safe_print_push_fill(context, info.fill ? info.fill : default_fill, space);
+    }
+    
+    if (info.char_case == SP_FI_UPPER_CASE || info.char_case == SP_FI_LOWER_CASE) {
+        safe_print_push_string_with_case(context, str.data, str.length, info.char_case);
+    } else {
+        safe_print_push_reference(context, str.data, str.length);
+    }
+    
+    if (align == SP_FI_ALIGN_LEFT) {
+        safe_print_push_fill(context, info.fill ? info.fill : default_fill, space);
+    }
+    
+}
+
+static void safe_print_format_arg(SafePrintContext *context, SafePrintFormatInfo info) {
+    SafePrintFormatArg const *arg = &context->args[info.arg_index];
+    
+    switch (arg->kind) {
+        case SAFE_PRINT_I32: {
+            if (safe_print_push_integer(context, info, arg->s32 < 0 ? (sp_u64)0 - (sp_u64)arg->s32 : (sp_u64)arg->s32, arg->s32 < 0, info.sign)) break;
+            
+            char buffer[128];
+            SafePrintStringRef str = safe_print_convert_signed_to_string(buffer, 128, arg->s32, SAFE_PRINT_BASE(info.base), info.char_case == SP_FI_UPPER_CASE, info.sign);
+            
+            safe_print_apply_format_info(context, str, info, '0');
+        } break;
+        
+        case SAFE_PRINT_U32: {
+            if (safe_print_push_integer(context, info, arg->u32, sp_false, sp_false)) break;
+            
+            char buffer[128];
+            SafePrintStringRef str = safe_print_convert_unsigned_to_string(buffer, 128, arg->u32, SAFE_PRINT_BASE(info.base), info.char_case == SP_FI_UPPER_CASE);
+            
+            safe_print_apply_format_info(context, str, info, '0');
+        } break;
+        
+        case SAFE_PRINT_I64: {
+            if (safe_print_push_integer(context, info, arg->s64 < 0 ? (sp_u64)0 - (sp_u64)arg->s64 : (sp_u64)arg->s64, arg->s64 < 0, info.sign)) break;
+            
+            char buffer[128];
+            SafePrintStringRef str = safe_print_convert_signed_to_string(buffer, 128, arg->s64, SAFE_PRINT_BASE(info.base), info.char_case == SP_FI_UPPER_CASE, info.sign);
+            
+            safe_print_apply_format_info(context, str, info, '0');
+        } break;
+        
+        case SAFE_PRINT_U64: {
+            if (safe_print_push_integer(context, info, arg->u64, sp_false, sp_false)) break;
+            
+            char buffer[128];
+            SafePrintStringRef str = safe_print_convert_unsigned_to_string(buffer, 128, arg->u64, SAFE_PRINT_BASE(info.base), info.char_case == SP_FI_UPPER_CASE);
+            
+            safe_print_apply_format_info(context, str, info, '0');
+        } break;
+        
+        case SAFE_PRINT_R64: {
+            char buffer[512];
+            SafePrintStringRef str = safe_print_convert_double_to_string(buffer, 512, arg->r64, SAFE_PRINT_PRECISION(info.precision), info.scientific, info.base == 16 ? sp_true : sp_false, info.char_case == SP_FI_UPPER_CASE, info.sign);
+            
+            safe_print_apply_format_info(context, str, info, '0');
+        } break;
+        
+        case SAFE_PRINT_R32: {
+            char buffer[512];
+            SafePrintStringRef str = safe_print_convert_float_to_string(buffer, 512, arg->r32, SAFE_PRINT_PRECISION(info.precision), info.scientific, info.base == 16 ? sp_true : sp_false, info.char_case == SP_FI_UPPER_CASE, info.sign);
+            
+            safe_print_apply_format_info(context, str, info, '0');
+        } break;
+        
+        case SAFE_PRINT_STR: {
+            // NOTE: Everything after max is cut off anyway, the padding only needs to know if the string is shorter than min.
+            sp_s64 limit = info.max ? (info.max > info.min ? info.max : info.min) : INT64_MAX;
+            
+            SafePrintStringRef str;
+            str.data = arg->str;
+            str.length = (int)safe_print_cstring_length_bounded(str.data, limit);
+            
+            safe_print_apply_format_info_to_string(context, str, info, ' ');
+        } break;
+        
+        case SAFE_PRINT_PTR: {
+            char buffer[128];
+            SafePrintStringRef str = safe_print_convert_unsigned_to_string(buffer, 128, (uintptr_t)arg->ptr, 16, sp_true);
+            
+            safe_print_apply_format_info(context, str, info, '0');
+        } break;
+        
+        case SAFE_PRINT_STR_REF: {
+            safe_print_apply_format_info_to_string(context, arg->str_ref, info, ' ');
+        } break;
+    }
+}
+
+static sp_b32 safe_print_is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static sp_b32 safe_print_is_letter(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static void safe_print_report_error(SafePrintContext *context, sp_u32 kind, char const *msg) {
+    context->error = kind;
+    
+#if defined(SAFE_PRINT_DEBUG)
+    safe_print_push_character(context, '\n');
+    safe_print_push_character(context, '\n');
+    safe_print_flush_buffer(context);
+    
+    printf("Error in format string: %s\n", msg);
+    
+    char const *fmt = context->fmt_start;
+    while (fmt[0]) {
+        if (fmt[0] == '\n') safe_print_push_character(context, ' ');
+        else safe_print_push_character(context, fmt[0]);
+        
+        fmt += 1;
+    }
+    safe_print_push_character(context, '\n');
+    for (sp_s32 i = 0; i < context->error_location; i += 1) {
+        safe_print_push_character(context, '-');
+    }
+    safe_print_push_character(context, '^');
+    safe_print_push_character(context, '\n');
+#endif
+}
+
+static SafePrintFormatToken safe_print_next_token(SafePrintContext *context) {
+    SafePrintFormatToken token = {0};
+    
+#if defined(SAFE_PRINT_DEBUG)
+    token.location = context->fmt - context->fmt_start;
+#endif // defined(SAFE_PRINT_DEBUG)
+    
+    while (context->fmt[0]) {
+        switch (context->fmt[0]) {
+            case '{': {
+                context->fmt += 1;
+                token.kind = SP_FT_OPENING_BRACE;
+                return token;
+            } break;
+            
+            case '}': {
+                context->fmt += 1;
+                token.kind = SP_FT_CLOSING_BRACE;
+                return token;
+            } break;
+            
+            case '(': {
+                context->fmt += 1;
+                token.kind = SP_FT_OPENING_PAREN;
+                return token;
+            } break;
+            
+            case ')': {
+                context->fmt += 1;
+                token.kind = SP_FT_CLOSING_PAREN;
+                return token;
+            } break;
+            
+            case ' ': case '\n': case '\r': case '\t': { // skip whitespaces
+                context->fmt += 1;
+            } break;
+            
+            case '0': case '1': case '2': case '3': case '4':
+            case '5': case '6': case '7': case '8': case '9': {
+                while (safe_print_is_digit(context->fmt[0])) {
+                    token.number *= 10;
+                    token.number += context->fmt[0] - '0';
+                    context->fmt += 1;
+                }
+                token.kind = SP_FT_NUMBER;
+                return token;
+            } break;
+            
+            case ':': {
+                context->fmt += 1;
+                token.kind = SP_FT_SEPERATOR;
+                return token;
+            } break;
+            
+            case '\0': {
+                token.kind = SP_FT_END_OF_INPUT;
+                return token;
+            } break;
+            
+            default: {
+                char const *str = context->fmt;
+                sp_s32 length = 0;
+                
+                if (!safe_print_is_letter(context->fmt[0])) {
+                    context->fmt += 1;
+                    token.kind = SP_FT_UNKOWN;
+                    return token;
+                }
+                
+                while (safe_print_is_letter(context->fmt[0])) {
+                    length += 1;
+                    context->fmt += 1;
+                }
+                
+                token.kind = SP_FT_STRING;
+                token.string.data = str;
+                token.string.length = length;
+                
+                
+                switch (str[0]) {
+                    case 'm': {
+                        if (length == 3 && str[1] == 'i' && str[2] == 'n')
+                            token.kind = SP_FT_KEYWORD_MIN;
+                        else if (length == 3 && str[1] == 'a' && str[2] == 'x')
+                            token.kind = SP_FT_KEYWORD_MAX;
+                    } break;
+                    
+                    case 'f': {
+                        if (safe_print_compare_string(token.string, "fill", 4))
+                            token.kind = SP_FT_KEYWORD_FILL;
+                    } break;
+                    
+                    case 'p': {
+                        if (safe_print_compare_string(token.string, "precision", 9))
+                            token.kind = SP_FT_KEYWORD_PREC;
+                    } break;
+                    
+                    case 'b': {
+                        if (length == 3 && str[1] == 'i' && str[2] == 'n')
+                            token.kind = SP_FT_BASE_BIN;
+                        else if (length == 4 && str[1] == 'a' && str[2] == 's' && str[3] == 'e')
+                            token.kind = SP_FT_KEYWORD_BASE;
+                    } break;
+                    
+                    case 'o': {
+                        if (length == 3 && str[1] == 'c' && str[2] == 't')
+                            token.kind = SP_FT_BASE_OCT;
+                    } break;
+                    
+                    case 'd': {
+                        if (length == 3 && str[1] == 'e' && str[2] == 'c')
+                            token.kind = SP_FT_BASE_DEC;
+                    } break;
+                    
+                    case 'h': {
+                        if (length == 3 && str[1] == 'e' && str[2] == 'x')
+                            token.kind = SP_FT_BASE_HEX;
+                    } break;
+                    
+                    case 'l': {
+                        if (length == 4 && str[1] == 'e' && str[2] == 'f' && str[3] == 't')
+                            token.kind = SP_FT_KEYWORD_LEFT;
+                        else if (safe_print_compare_string(token.string, "lower", 5))
+                            token.kind = SP_FT_KEYWORD_LOWER;
+                    } break;
+                    
+                    case 'u': {
+                        if (safe_print_compare_string(token.string, "upper", 5))
+                            token.kind = SP_FT_KEYWORD_UPPER;
+                    } break;
+                    
+                    case 'r': {
+                        if (safe_print_compare_string(token.string, "right", 5))
+                            token.kind = SP_FT_KEYWORD_RIGHT;
+                    } break;
+                    
+                    case 's': {
+                        if (length == 3 && str[1] == 'c' && str[2] == 'i')
+                            token.kind = SP_FT_KEYWORD_SCI;
+                        else if (length == 4 && str[1] == 'i' && str[2] == 'g' && str[3] == 'n')
+                            token.kind = SP_FT_KEYWORD_SIGN;
+                        else if (safe_print_compare_string(token.string, "short", 5))
+                            token.kind = SP_FT_KEYWORD_SHORT;
+                    } break;
+                    
+                }
+                
+                return token;
+            }
+        }
+    }
+    token.kind = SP_FT_UNKOWN;
+    return token;
+}
+
+static SafePrintFormatToken safe_print_consume_next_token(SafePrintContext *context, sp_u32 kind, char const *msg) {
+    SafePrintFormatToken token = safe_print_next_token(context);
+    if (token.kind != kind) {
+        SAFE_PRINT_DEBUG_ERROR_LOCATION(context, token.location);
+        safe_print_report_error(context, SP_ERROR_UNKNOWN_FORMAT_SPECIFIER , msg);
+    }
+    
+    return token;
+}
+
+static sp_b32 safe_print_parse_format_function(SafePrintContext *context, SafePrintFormatToken *out) {
+    SafePrintFormatToken opening = safe_print_next_token(context);
+    if (opening.kind != SP_FT_OPENING_PAREN) {
+        SAFE_PRINT_DEBUG_ERROR_LOCATION(context, opening.location);
+        safe_print_report_error(context, SP_ERROR_UNKNOWN_FORMAT_SPECIFIER , "Missing ( after format specifier.");
+        return sp_false;
+    }
+    *out = safe_print_next_token(context);
+    
+    SafePrintFormatToken closing = safe_print_next_token(context);
+    if (closing.kind != SP_FT_CLOSING_PAREN) {
+        SAFE_PRINT_DEBUG_ERROR_LOCATION(context, opening.location);
+        safe_print_report_error(context, SP_ERROR_UNKNOWN_FORMAT_SPECIFIER , "Missing closing ).");
+        return sp_false;
+    }
+    
+    return sp_true;
+}
+
+enum {
+    SP_PFS_OK,
+    SP_PFS_ERROR,
+    SP_PFS_ESCAPED_BRACE
+};
+static sp_s32 safe_print_parse_format_specifier(SafePrintContext *context, SafePrintFormatInfo *out) {
+    SafePrintFormatInfo info = {0};
+    info.arg_index = -1;
+    
+    SafePrintFormatToken opening_brace = safe_print_next_token(context);
+    if (opening_brace.kind != SP_FT_OPENING_BRACE) {
+        SAFE_PRINT_DEBUG_ERROR_LOCATION(context, opening_brace.location);
+        safe_print_report_error(context, SP_ERROR_UNKNOWN_FORMAT_SPECIFIER , "Implementation error. Wrong call to safe_print_parse_format_specifier.");
+        return SP_PFS_ERROR;
+    }
+    if (context->fmt[0] == '{') {
+        context->fmt += 1;
+        return SP_PFS_ESCAPED_BRACE;
+    }
+    
+    SafePrintFormatToken token;
+    
+    if (context->fmt[0] != '}') {
+        do {
+            token = safe_print_next_token(context);
+            switch (token.kind) {
+                case SP_FT_NUMBER: {
+                    if (token.number < 0 || token.number > context->arg_count) {
+                        SAFE_PRINT_DEBUG_ERROR_LOCATION(context, token.location);
+                        safe_print_report_error(context, SP_ERROR_POSITIONAL_ARG_OUT_OF_RANGE , "Bad argument index.");
+                        return SP_PFS_ERROR;
+                    }
+                    info.arg_index = token.number - 1;
+                } break;
+                
+                case SP_FT_KEYWORD_MIN: {
+                    SafePrintFormatToken token;
+                    if (!safe_print_parse_format_function(context, &token))
+                        return SP_PFS_ERROR;
+                    
+                    if (token.kind != SP_FT_NUMBER) {
+                        SAFE_PRINT_DEBUG_ERROR_LOCATION(context, token.location);
+                        safe_print_report_error(context, SP_ERROR_UNKNOWN_FORMAT_SPECIFIER , "Expected number in min specifier.");
+                        return SP_PFS_ERROR;
+                    }
+                    info.min = token.number;
+                } break;
+                
+                case SP_FT_KEYWORD_MAX: {
+                    safe_print_consume_next_token(context, SP_FT_OPENING_PAREN, "Missing ( after max specifier.");
+                    SafePrintFormatToken token = safe_print_consume_next_token(context, SP_FT_NUMBER, "Expected number inside max specifier.");
+                    info.max = token.number;
+                    safe_print_consume_next_token(context, SP_FT_CLOSING_PAREN, "Missing ) after max specifier.");
+                    if (context->error) return SP_PFS_ERROR;
+                } break;
+                
+                case SP_FT_KEYWORD_FILL: {
+                    safe_print_consume_next_token(context, SP_FT_OPENING_PAREN, "Missing ( after fill specifier.");
+                    info.fill = context->fmt[0];
+                    if (context->fmt[0]) context->fmt += 1;
+                    safe_print_consume_next_token(context, SP_FT_CLOSING_PAREN, "Missing ) after fill specifier.");
+                    if (context->error) return SP_PFS_ERROR;
+                } break;
+                
+                case SP_FT_KEYWORD_PREC: {
+                    safe_print_consume_next_token(context, SP_FT_OPENING_PAREN, "Missing ( after fill specifier.");
+                    SafePrintFormatToken token = safe_print_consume_next_token(context, SP_FT_NUMBER, "Expected number inside precision specifier.");
+                    info.precision = token.number;
+                    safe_print_consume_next_token(context, SP_FT_CLOSING_PAREN, "Missing ) after fill specifier.");
+                    if (context->error) return SP_PFS_ERROR;
+                } break;
+                
+                case SP_FT_KEYWORD_LEFT: { info.alignment = SP_FI_ALIGN_LEFT; } break;
+                case SP_FT_KEYWORD_RIGHT: { info.alignment = SP_FI_ALIGN_RIGHT; } break;
+                
+                case SP_FT_KEYWORD_BASE: {
+                    safe_print_consume_next_token(context, SP_FT_OPENING_PAREN, "Missing ( after fill specifier.");
+                    SafePrintFormatToken token = safe_print_consume_next_token(context, SP_FT_NUMBER, "Expected number inside precision specifier.");
+                    info.base = token.number;
+                    safe_print_consume_next_token(context, SP_FT_CLOSING_PAREN, "Missing ) after fill specifier.");
+                    if (context->error) return SP_PFS_ERROR;
+                    
+                    if (info.base == 1 || info.base > 36) {
+                        SAFE_PRINT_DEBUG_ERROR_LOCATION(context, token.location);
+                        safe_print_report_error(context, SP_ERROR_UNKNOWN_FORMAT_SPECIFIER , "Base has to be between 2 and 36.");
+                        return SP_PFS_ERROR;
+                    }
+                } break;
+                
+                case SP_FT_KEYWORD_SCI: { info.scientific = sp_true; } break;
+                case SP_FT_KEYWORD_SHORT: { info.precision = 0; } break;
+                case SP_FT_KEYWORD_SIGN: { info.sign = sp_true; } break;
+                
+                case SP_FT_KEYWORD_LOWER: { info.char_case = SP_FI_LOWER_CASE; } break;
+                case SP_FT_KEYWORD_UPPER: { info.char_case = SP_FI_UPPER_CASE; } break;
+                
+                case SP_FT_BASE_BIN: { info.base = 2; } break;
+                case SP_FT_BASE_OCT: { info.base = 8; } break;
+                case SP_FT_BASE_DEC: { info.base = 10; } break;
+                case SP_FT_BASE_HEX: { info.base = 16; } break;
+                
+                case SP_FT_STRING: {
+                    SAFE_PRINT_DEBUG_ERROR_LOCATION(context, token.location);
+                    safe_print_report_error(context, SP_ERROR_UNKNOWN_FORMAT_SPECIFIER , "Unknown format specifier.");
+                    return SP_PFS_ERROR;
+                } break;
+                
+                case SP_FT_END_OF_INPUT: {
+                    SAFE_PRINT_DEBUG_ERROR_LOCATION(context, token.location);
+                    safe_print_report_error(context, SP_ERROR_MISSING_BRACE , "Reached end of format string, missing }.");
+                    return SP_PFS_ERROR;
+                } break;
+                
+                case SP_FT_UNKOWN: {
+                    SAFE_PRINT_DEBUG_ERROR_LOCATION(context, opening_brace.location);
+                    safe_print_report_error(context, SP_ERROR_UNKNOWN_FORMAT_SPECIFIER , "Missing } in format specifier.");
+                    return SP_PFS_ERROR;
+                } break;
+            }
+            
+            token = safe_print_next_token(context);
+        } while (token.kind == SP_FT_SEPERATOR);
+        
+    } else {
+        token = safe_print_next_token(context);
+    }
+    
+    if (token.kind != SP_FT_CLOSING_BRACE) {
+        SAFE_PRINT_DEBUG_ERROR_LOCATION(context, opening_brace.location);
+        safe_print_report_error(context, SP_ERROR_MISSING_BRACE , "Missing } in format specifier.");
+        return SP_PFS_ERROR;
+    }
+    
+    if (info.arg_index == -1) {
+        info.arg_index = context->current_index;
+        if (info.arg_index == context->arg_count) {
+            SAFE_PRINT_DEBUG_ERROR_LOCATION(context, opening_brace.location);
+            safe_print_report_error(context, SP_ERROR_TOO_MANY_ARGUMENTS , "Not enough print arguments for this format specifier");
+            return SP_PFS_ERROR;
+        }
+        context->current_index += 1;
+    }
+    
+    *out = info;
+    return SP_PFS_OK;
+}
+
+static sp_s32 safe_print_format(SafePrintContext *context) {
+    while (context->fmt[0]) {
+        if (context->error) {
+            safe_print_flush_buffer(context);
+            return context->error;
+        }
+        
+        if (context->fmt[0] == '{') {
+            SafePrintFormatInfo info;
+            sp_s32 status = safe_print_parse_format_specifier(context, &info);
+            if (status == SP_PFS_ERROR) {
+                safe_print_flush_buffer(context);
+                return SP_ERROR_UNKNOWN_FORMAT_SPECIFIER ;
+            } else if (status == SP_PFS_ESCAPED_BRACE) {
+                safe_print_push_character(context, '{');
+            } else {
+                safe_print_format_arg(context, info);
+            }
+        } else if (context->fmt[0] == '}') {
+            if (context->fmt[1] == '}') {
+                safe_print_push_character(context, '}');
+                context->fmt += 2;
+            } else {
+                SAFE_PRINT_DEBUG_ERROR_LOCATION(context, context->fmt - context->fmt_start);
+                safe_print_report_error(context, SP_ERROR_MISSING_BRACE , "stray } in format string.");
+                context->fmt += 1;
+            }
+        } else {
+            char const *end = safe_print_find_brace(context->fmt);
+            safe_print_push_reference(context, context->fmt, end - context->fmt);
+            context->fmt = end;
+        }
+    }
+    
+    safe_print_flush_buffer(context);
+    if (context->error) return context->error;
+    
+    return context->written;
+}
+
+/*
+ * Parses the whole format string once and stores literal runs and the resolved format
+ * info of every argument. The arguments are only known when the format is used, so
+ * every index is accepted here and checked against arg_count later.
+ */
+SafePrintCompiledFormat safe_print_compile(char const *fmt) {
+    SafePrintCompiledFormat result = {0};
+    
+    SafePrintContext context = {0};
+    context.fmt_start = fmt;
+    context.fmt = fmt;
+    context.file = SafePrintStdOut;
+    context.target = SP_TARGET_FILE;
+    context.buffer = context.staging;
+    context.buffer_size = SAFE_PRINT_BUFFER_SIZE;
+    context.arg_count = INT32_MAX;
+    
+    while (context.fmt[0] && !context.error) {
+        if (result.op_count == SAFE_PRINT_MAX_FORMAT_OPS) {
+            result.error = SP_ERROR_FORMAT_TOO_LONG;
+            return result;
+        }
+        SafePrintFormatOp *op = &result.ops[result.op_count];
         
-        case SAFE_PRINT_STR: {
-            SafePrintStringRef str;
-            str.data = arg->str;
-            str.length = safe_print_cstring_length(str.data);
+        if (context.fmt[0] == '{') {
+            char const *brace = context.fmt;
             
-            safe_print_apply_format_info_to_string(context, str, info, ' ');
-        } break;
-        
-        case SAFE_PRINT_PTR: {
-            char buffer[128];
-            SafePrintStringRef str = safe_print_convert_signed_to_string(buffer, 128, arg->s32, 16, sp_true, sp_false);
+            SafePrintFormatInfo info;
+            sp_s32 status = safe_print_parse_format_specifier(&context, &info);
+            if (status == SP_PFS_ERROR) {
+                break;
+            } else if (status == SP_PFS_ESCAPED_BRACE) {
+                op->kind = SP_OP_LITERAL;
+                op->literal.data = brace;
+                op->literal.length = 1;
+            } else {
+                op->kind = SP_OP_ARG;
+                op->info = info;
+                if (info.arg_index >= result.arg_count) result.arg_count = info.arg_index + 1;
+            }
+        } else if (context.fmt[0] == '}') {
+            if (context.fmt[1] != '}') {
+                SAFE_PRINT_DEBUG_ERROR_LOCATION(&context, context.fmt - context.fmt_start);
+                safe_print_report_error(&context, SP_ERROR_MISSING_BRACE , "stray } in format string.");
+                break;
+            }
             
-            safe_print_apply_format_info(context, str, info, '0');
-        } break;
+            op->kind = SP_OP_LITERAL;
+            op->literal.data = context.fmt;
+            op->literal.length = 1;
+            context.fmt += 2;
+        } else {
+            char const *end = safe_print_find_brace(context.fmt);
+            
+            op->kind = SP_OP_LITERAL;
+            op->literal.data = context.fmt;
+            op->literal.length = (int)(end - context.fmt);
+            context.fmt = end;
+        }
+        
+        result.op_count += 1;
     }
+    
+    // NOTE: Only the error report of SAFE_PRINT_DEBUG could be waiting here.
+    safe_print_flush_buffer(&context);
+    result.error = context.error;
+    
+    return result;
 }
 
-static sp_b32 safe_print_is_digit(char c) {
-    return c >= '0' && c <= '9';
+static sp_s32 safe_print_format_ops(SafePrintContext *context, SafePrintFormatOp const *ops, sp_s32 op_count) {
+    for (sp_s32 i = 0; i < op_count; i += 1) {
+        SafePrintFormatOp const *op = &ops[i];
+        
+        if (op->kind == SP_OP_LITERAL) {
+            safe_print_push_reference(context, op->literal.data, op->literal.length);
+        } else {
+            safe_print_format_arg(context, op->info);
+        }
+    }
+    
+    safe_print_flush_buffer(context);
+    if (context->error) return context->error;
+    
+    return context->written;
 }
 
-static sp_b32 safe_print_is_letter(char c) {
-    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+static sp_s32 safe_print_format_compiled(SafePrintContext *context, SafePrintCompiledFormat const *format) {
+    if (format->error) return format->error;
+    if (context->arg_count < format->arg_count) return SP_ERROR_TOO_MANY_ARGUMENTS;
+    
+    return safe_print_format_ops(context, format->ops, format->op_count);
 }
 
-static void safe_print_report_error(SafePrintContext *context, sp_u32 kind, char const *msg) {
-    context->error = kind;
+static sp_u32 safe_print_hash_pointer(void const *ptr) {
+    sp_u64 value = (uintptr_t)ptr;
+    value *= 0x9E3779B97F4A7C15ULL;
     
-#if defined(SAFE_PRINT_DEBUG)
-    safe_print_output_character(context, '\n');
-    safe_print_output_character(context, '\n');
+    return (sp_u32)(value >> 32);
+}
+
+#if defined(SAFE_PRINT_FORMAT_CACHE_SIZE)
+/*
+ * Every thread keeps the compiled formats of the format strings it used last, keyed by
+ * the address of the format string. A slot is looked up by linear probing over at most
+ * SAFE_PRINT_FORMAT_CACHE_PROBES slots, if none is free the first one is replaced.
+ */
+#if !defined(SAFE_PRINT_FORMAT_CACHE_PROBES)
+#define SAFE_PRINT_FORMAT_CACHE_PROBES 8
+#endif
+
+typedef struct SafePrintFormatCache {
+    sp_u64 hits;
+    sp_u64 misses;
+    char const *keys[SAFE_PRINT_FORMAT_CACHE_SIZE];
+    SafePrintCompiledFormat formats[SAFE_PRINT_FORMAT_CACHE_SIZE];
+} SafePrintFormatCache;
+
+static SAFE_PRINT_THREAD_LOCAL SafePrintFormatCache safe_print_format_cache;
+
+SafePrintFormatCacheStats safe_print_format_cache_stats(void) {
+    SafePrintFormatCacheStats stats;
+    stats.hits = safe_print_format_cache.hits;
+    stats.misses = safe_print_format_cache.misses;
     
-    printf("Error in format string: %s\n", msg);
+    return stats;
+}
+
+/*
+ * Formats with the cached compiled format of context->fmt if there is one. Otherwise the
+ * format string is interpreted as usual and compiled afterwards if that went well, so
+ * output and error reports never differ from the uncached path.
+ */
+static sp_s32 safe_print_format_cached(SafePrintContext *context) {
+    SafePrintFormatCache *cache = &safe_print_format_cache;
+    char const *fmt = context->fmt;
     
-    char const *fmt = context->fmt_start;
-    while (fmt[0]) {
-        if (fmt[0] == '\n') safe_print_output_character(context, ' ');
-        else safe_print_output_character(context, fmt[0]);
+    sp_u32 mask = SAFE_PRINT_FORMAT_CACHE_SIZE - 1;
+    sp_u32 home = safe_print_hash_pointer(fmt) & mask;
+    sp_u32 slot = home;
+    sp_s32 probes = 0;
+    while (probes < SAFE_PRINT_FORMAT_CACHE_PROBES && probes < SAFE_PRINT_FORMAT_CACHE_SIZE) {
+        if (cache->keys[slot] == 0) break;
+        if (cache->keys[slot] == fmt) {
+            // NOTE: Formats that are too long or calls with missing arguments take the normal path.
+            SafePrintCompiledFormat const *format = &cache->formats[slot];
+            if (format->error || context->arg_count < format->arg_count) break;
+            
+            cache->hits += 1;
+            return safe_print_format_compiled(context, format);
+        }
         
-        fmt += 1;
+        slot = (slot + 1) & mask;
+        probes += 1;
     }
-    safe_print_output_character(context, '\n');
-    for (sp_s32 i = 0; i < context->error_location; i += 1) {
-        safe_print_output_character(context, '-');
+    
+    cache->misses += 1;
+    sp_s32 result = safe_print_format(context);
+    if (context->error) return result;
+    
+    // NOTE: All probed slots are taken, so the first one is replaced.
+    if (probes == SAFE_PRINT_FORMAT_CACHE_PROBES || probes == SAFE_PRINT_FORMAT_CACHE_SIZE) slot = home;
+    if (cache->keys[slot] != fmt) {
+        cache->keys[slot] = fmt;
+        cache->formats[slot] = safe_print_compile(fmt);
     }
-    safe_print_output_character(context, '^');
-    safe_print_output_character(context, '\n');
+    
+    return result;
+}
+#else
+#define safe_print_format_cached safe_print_format
+#endif // defined(SAFE_PRINT_FORMAT_CACHE_SIZE)
+
+static void safe_print_init_file_context(SafePrintContext *context, SafePrintFileType handle, char const *fmt) {
+    context->fmt_start = fmt;
+    context->fmt = fmt;
+    context->file = handle;
+    context->target = SP_TARGET_FILE;
+    context->buffer = context->staging;
+    context->buffer_size = SAFE_PRINT_BUFFER_SIZE;
+}
+
+int safe_print_runtime_level = SAFE_PRINT_LEVEL_TRACE;
+
+void safe_print_set_runtime_level(int level) {
+#if defined(__GNUC__) || defined(__clang__)
+    __atomic_store_n(&safe_print_runtime_level, level, __ATOMIC_RELAXED);
+#else
+    *(int volatile*)&safe_print_runtime_level = level;
 #endif
 }
 
-static SafePrintFormatToken safe_print_next_token(SafePrintContext *context) {
-    SafePrintFormatToken token = {0};
+int safe_print_implementation(SafePrintFileType handle, char const *fmt, SafePrintFormatArg const *args, int arg_count) {
+    SafePrintContext context = {0};
+    safe_print_init_file_context(&context, handle, fmt);
+    context.args = args;
+    context.arg_count = arg_count;
     
-#if defined(SAFE_PRINT_DEBUG)
-    token.location = context->fmt - context->fmt_start;
-#endif // defined(SAFE_PRINT_DEBUG)
+    safe_print_lock_file(handle);
+    sp_s32 result = safe_print_format_cached(&context);
+    safe_print_unlock_file(handle);
     
-    while (context->fmt[0]) {
-        switch (context->fmt[0]) {
-            case '{': {
-                context->fmt += 1;
-                token.kind = SP_FT_OPENING_BRACE;
-                return token;
-            } break;
-            
-            case '}': {
-                context->fmt += 1;
-                token.kind = SP_FT_CLOSING_BRACE;
-                return token;
-            } break;
-            
-            case '(': {
-                context->fmt += 1;
-                token.kind = SP_FT_OPENING_PAREN;
-                return token;
-            } break;
-            
-            case ')': {
-                context->fmt += 1;
-                token.kind = SP_FT_CLOSING_PAREN;
-                return token;
-            } break;
-            
-            case ' ': case '\n': case '\r': case '\t': { // skip whitespaces
-                context->fmt += 1;
-            } break;
-            
-            case '0': case '1': case '2': case '3': case '4':
-            case '5': case '6': case '7': case '8': case '9': {
-                while (safe_print_is_digit(context->fmt[0])) {
-                    token.number *= 10;
-                    token.number += context->fmt[0] - '0';
-                    context->fmt += 1;
-                }
-                token.kind = SP_FT_NUMBER;
-                return token;
-            } break;
-            
-            case ':': {
-                context->fmt += 1;
-                token.kind = SP_FT_SEPERATOR;
-                return token;
-            } break;
-            
-            case '\0': {
-                token.kind = SP_FT_END_OF_INPUT;
-                return token;
-            } break;
-            
-            default: {
-                char const *str = context->fmt;
-                sp_s32 length = 0;
-                
-                if (!safe_print_is_letter(context->fmt[0])) {
-                    context->fmt += 1;
-                    token.kind = SP_FT_UNKOWN;
-                    return token;
-                }
-                
-                while (safe_print_is_letter(context->fmt[0])) {
-                    length += 1;
-                    context->fmt += 1;
-                }
-                
-                token.kind = SP_FT_STRING;
-                token.string.data = str;
-                token.string.length = length;
-                
-                
-                switch (str[0]) {
-                    case 'm': {
-                        if (length == 3 && str[1] == 'i' && str[2] == 'n')
-                            token.kind = SP_FT_KEYWORD_MIN;
-                        else if (length == 3 && str[1] == 'a' && str[2] == 'x')
-                            token.kind = SP_FT_KEYWORD_MAX;
-                    } break;
-                    
-                    case 'f': {
-                        if (safe_print_compare_string(token.string, "fill", 4))
-                            token.kind = SP_FT_KEYWORD_FILL;
-                    } break;
-                    
-                    case 'p': {
-                        if (safe_print_compare_string(token.string, "precision", 9))
-                            token.kind = SP_FT_KEYWORD_PREC;
-                    } break;
-                    
-                    case 'b': {
-                        if (length == 3 && str[1] == 'i' && str[2] == 'n')
-                            token.kind = SP_FT_BASE_BIN;
-                        else if (length == 4 && str[1] == 'a' && str[2] == 's' && str[3] == 'e')
-                            token.kind = SP_FT_KEYWORD_BASE;
-                    } break;
-                    
-                    case 'o': {
-                        if (length == 3 && str[1] == 'c' && str[2] == 't')
-                            token.kind = SP_FT_BASE_OCT;
-                    } break;
-                    
-                    case 'd': {
-                        if (length == 3 && str[1] == 'e' && str[2] == 'c')
-                            token.kind = SP_FT_BASE_DEC;
-                    } break;
-                    
-                    case 'h': {
-                        if (length == 3 && str[1] == 'e' && str[2] == 'x')
-                            token.kind = SP_FT_BASE_HEX;
-                    } break;
-                    
-                    case 'l': {
-                        if (length == 4 && str[1] == 'e' && str[2] == 'f' && str[3] == 't')
-                            token.kind = SP_FT_KEYWORD_LEFT;
-                        else if (safe_print_compare_string(token.string, "lower", 5))
-                            token.kind = SP_FT_KEYWORD_LOWER;
-                    } break;
-                    
-                    case 'u': {
-                        if (safe_print_compare_string(token.string, "upper", 5))
-                            token.kind = SP_FT_KEYWORD_UPPER;
-                    } break;
-                    
-                    case 'r': {
-                        if (safe_print_compare_string(token.string, "right", 5))
-                            token.kind = SP_FT_KEYWORD_RIGHT;
-                    } break;
-                    
-                    case 's': {
-                        if (length == 3 && str[1] == 'c' && str[2] == 'i')
-                            token.kind = SP_FT_KEYWORD_SCI;
-                        else if (length == 4 && str[1] == 'i' && str[2] == 'g' && str[3] == 'n')
-                            token.kind = SP_FT_KEYWORD_SIGN;
-                    } break;
-                    
-                }
-                
-                return token;
-            }
-        }
+    return result;
+}
+
+int safe_print_compiled_implementation(SafePrintFileType handle, SafePrintCompiledFormat const *format, SafePrintFormatArg const *args, int arg_count) {
+    SafePrintContext context = {0};
+    safe_print_init_file_context(&context, handle, "");
+    context.args = args;
+    context.arg_count = arg_count;
+    
+    safe_print_lock_file(handle);
+    sp_s32 result = safe_print_format_compiled(&context, format);
+    safe_print_unlock_file(handle);
+    
+    return result;
+}
+
+int safe_print_buffer_implementation(char *buffer, size_t size, char const *fmt, SafePrintFormatArg const *args, int arg_count) {
+    SafePrintContext context = {0};
+    context.fmt_start = fmt;
+    context.fmt = fmt;
+    context.target = SP_TARGET_MEMORY;
+    context.buffer = buffer;
+    // NOTE: One byte is always kept for the terminating 0.
+    context.buffer_size = size ? (size - 1 < INT32_MAX ? (sp_s32)(size - 1) : INT32_MAX) : 0;
+    context.args = args;
+    context.arg_count = arg_count;
+    
+    sp_s32 result = safe_print_format_cached(&context);
+    if (size) buffer[context.buffer_used] = '\0';
+    
+    return result;
+}
+
+/*
+ * Formats once and hands every flushed part of the staging buffer to all sinks in order.
+ */
+int safe_print_sinks_implementation(SafePrintSink const *sinks, int sink_count, char const *fmt, SafePrintFormatArg const *args, int arg_count) {
+    if (sink_count > SAFE_PRINT_MAX_SINKS) return SP_ERROR_TOO_MANY_SINKS;
+    
+    SafePrintContext context = {0};
+    context.fmt_start = fmt;
+    context.fmt = fmt;
+    context.target = SP_TARGET_SINKS;
+    context.sinks = sinks;
+    context.sink_count = sink_count;
+    context.buffer = context.staging;
+    context.buffer_size = SAFE_PRINT_BUFFER_SIZE;
+    context.args = args;
+    context.arg_count = arg_count;
+    
+    sp_s32 result = safe_print_format_cached(&context);
+    if (result >= 0 && context.failed_sinks) return sp_true;
+    
+    return result;
+}
+
+int safe_vprint_file(SafePrintFileType handle, char const *fmt, SafePrintArgs args) {
+    return safe_print_implementation(handle, fmt, args.args, args.count);
+}
+
+int safe_vprint_buffer(char *buffer, size_t size, char const *fmt, SafePrintArgs args) {
+    return safe_print_buffer_implementation(buffer, size, fmt, args.args, args.count);
+}
+
+/*
+ * Entry points for callers that already resolved the format and the argument kinds,
+ * like the C++ front end. The ops are trusted, every arg_index has to be below arg_count.
+ */
+int safe_print_ops_implementation(SafePrintFileType handle, SafePrintFormatOp const *ops, int op_count, SafePrintFormatArg const *args, int arg_count) {
+    SafePrintContext context = {0};
+    safe_print_init_file_context(&context, handle, "");
+    context.args = args;
+    context.arg_count = arg_count;
+    
+    safe_print_lock_file(handle);
+    sp_s32 result = safe_print_format_ops(&context, ops, op_count);
+    safe_print_unlock_file(handle);
+    
+    return result;
+}
+
+int safe_print_buffer_ops_implementation(char *buffer, size_t size, SafePrintFormatOp const *ops, int op_count, SafePrintFormatArg const *args, int arg_count) {
+    SafePrintContext context = {0};
+    context.fmt_start = "";
+    context.fmt = "";
+    context.target = SP_TARGET_MEMORY;
+    context.buffer = buffer;
+    // NOTE: One byte is always kept for the terminating 0.
+    context.buffer_size = size ? (size - 1 < INT32_MAX ? (sp_s32)(size - 1) : INT32_MAX) : 0;
+    context.args = args;
+    context.arg_count = arg_count;
+    
+    sp_s32 result = safe_print_format_ops(&context, ops, op_count);
+    if (size) buffer[context.buffer_used] = '\0';
+    
+    return result;
+}
+
+
+#if defined(SAFE_PRINT_ASYNC)
+
+/*
+ * Async mode:
+ *
+ * The calling thread only decodes the arguments into a slot of a bounded ring buffer
+ * and copies strings into the slot as well. A background thread takes the slots out in
+ * order and runs the usual parser and conversion on them.
+ * The ring buffer is the bounded MPMC queue by Dmitry Vyukov with a single consumer.
+ * Every slot carries a sequence number that tells producers and the consumer whose
+ * turn it is, so no locks are needed.
+ * Once the queue stayed empty for a while the consumer parks on a condition variable
+ * and the next producer wakes it up, so an idle logger doesn't use the CPU. Producers
+ * count themselves in while they use the queue, so safe_print_async_stop can wait for
+ * them and calls that come too late print on their own thread instead.
+ */
+typedef struct SafePrintAsyncRecord {
+    atomic_size_t sequence;
+    
+    SafePrintFileType file;
+    char const *fmt;
+    sp_s32 arg_count;
+    SafePrintFormatArg args[SAFE_PRINT_ASYNC_MAX_ARGS];
+    char strings[SAFE_PRINT_ASYNC_STRING_SPACE];
+} SafePrintAsyncRecord;
+
+static struct {
+    SafePrintAsyncRecord records[SAFE_PRINT_ASYNC_QUEUE_SIZE];
+    atomic_size_t enqueue_position;
+    size_t dequeue_position;
+    
+    atomic_int running;
+    atomic_int draining;
+    atomic_int producers;
+    atomic_ullong dropped;
+    int overflow_policy;
+    thrd_t thread;
+    
+    atomic_int sleeping;
+    mtx_t wake_lock;
+    cnd_t wake;
+} SafePrintAsync;
+
+// NOTE: Called with wake_lock held. Storing sleeping and the sequence of a record are seq_cst
+//       here and in the producer, so either the producer sees sleeping or the consumer sees
+//       the new record.
+static void safe_print_async_park(SafePrintAsyncRecord *record, size_t position) {
+    atomic_store(&SafePrintAsync.sleeping, sp_true);
+    
+    if (atomic_load(&record->sequence) != position + 1 && atomic_load(&SafePrintAsync.running)) {
+        cnd_wait(&SafePrintAsync.wake, &SafePrintAsync.wake_lock);
     }
-    token.kind = SP_FT_UNKOWN;
-    return token;
+    
+    atomic_store_explicit(&SafePrintAsync.sleeping, sp_false, memory_order_relaxed);
 }
 
-static SafePrintFormatToken safe_print_consume_next_token(SafePrintContext *context, sp_u32 kind, char const *msg) {
-    SafePrintFormatToken token = safe_print_next_token(context);
-    if (token.kind != kind) {
-        SAFE_PRINT_DEBUG_ERROR_LOCATION(context, token.location);
-        safe_print_report_error(context, SP_ERROR_UNKNOWN_FORMAT_SPECIFIER , msg);
+static void safe_print_async_wake(void) {
+    mtx_lock(&SafePrintAsync.wake_lock);
+    cnd_signal(&SafePrintAsync.wake);
+    mtx_unlock(&SafePrintAsync.wake_lock);
+}
+
+static int safe_print_async_thread(void *data) {
+    (void)data;
+    sp_s32 idle = 0;
+    
+    for (;;) {
+        size_t position = SafePrintAsync.dequeue_position;
+        SafePrintAsyncRecord *record = &SafePrintAsync.records[position & (SAFE_PRINT_ASYNC_QUEUE_SIZE - 1)];
+        
+        if (atomic_load_explicit(&record->sequence, memory_order_acquire) != position + 1) {
+            int running = atomic_load(&SafePrintAsync.running);
+            if (!running) {
+                // NOTE: Producers could still be in the middle of writing a reserved slot or
+                //       waiting for room in a full queue.
+                if (atomic_load(&SafePrintAsync.producers) == 0 &&
+                    atomic_load(&SafePrintAsync.enqueue_position) == position) break;
+            }
+            
+            idle += 1;
+#if defined(SAFE_PRINT_THREAD_BUFFER_SIZE)
+            // NOTE: Nothing else would write the buffer of the background thread while the queue is empty.
+            if (idle == 1) safe_print_flush();
+#endif
+            if (idle < 64 || !running) {
+                thrd_yield();
+            } else {
+                mtx_lock(&SafePrintAsync.wake_lock);
+                safe_print_async_park(record, position);
+                mtx_unlock(&SafePrintAsync.wake_lock);
+            }
+            continue;
+        }
+        idle = 0;
+        
+        SafePrintContext context = {0};
+        safe_print_init_file_context(&context, record->file, record->fmt);
+        context.arg_count = record->arg_count;
+        context.args = record->args;
+        
+        safe_print_lock_file(record->file);
+        safe_print_format(&context);
+        safe_print_unlock_file(record->file);
+        
+        SafePrintAsync.dequeue_position = position + 1;
+        atomic_store_explicit(&record->sequence, position + SAFE_PRINT_ASYNC_QUEUE_SIZE, memory_order_release);
     }
     
-    return token;
+#if defined(SAFE_PRINT_THREAD_BUFFER_SIZE)
+    safe_print_flush();
+#endif
+    atomic_store(&SafePrintAsync.draining, sp_false);
+    
+    return 0;
 }
 
-static sp_b32 safe_print_parse_format_function(SafePrintContext *context, SafePrintFormatToken *out) {
-    SafePrintFormatToken opening = safe_print_next_token(context);
-    if (opening.kind != SP_FT_OPENING_PAREN) {
-        SAFE_PRINT_DEBUG_ERROR_LOCATION(context, opening.location);
-        safe_print_report_error(context, SP_ERROR_UNKNOWN_FORMAT_SPECIFIER , "Missing ( after format specifier.");
+int safe_print_async_start(int overflow_policy) {
+    if (atomic_load(&SafePrintAsync.running)) return sp_false;
+    
+    for (size_t i = 0; i < SAFE_PRINT_ASYNC_QUEUE_SIZE; i += 1) {
+        atomic_store_explicit(&SafePrintAsync.records[i].sequence, i, memory_order_relaxed);
+    }
+    atomic_store_explicit(&SafePrintAsync.enqueue_position, 0, memory_order_relaxed);
+    atomic_store_explicit(&SafePrintAsync.dropped, 0, memory_order_relaxed);
+    SafePrintAsync.dequeue_position = 0;
+    SafePrintAsync.overflow_policy = overflow_policy;
+    atomic_store_explicit(&SafePrintAsync.sleeping, sp_false, memory_order_relaxed);
+    
+    if (mtx_init(&SafePrintAsync.wake_lock, mtx_plain) != thrd_success) return sp_false;
+    if (cnd_init(&SafePrintAsync.wake) != thrd_success) {
+        mtx_destroy(&SafePrintAsync.wake_lock);
         return sp_false;
     }
-    *out = safe_print_next_token(context);
     
-    SafePrintFormatToken closing = safe_print_next_token(context);
-    if (closing.kind != SP_FT_CLOSING_PAREN) {
-        SAFE_PRINT_DEBUG_ERROR_LOCATION(context, opening.location);
-        safe_print_report_error(context, SP_ERROR_UNKNOWN_FORMAT_SPECIFIER , "Missing closing ).");
+    atomic_store(&SafePrintAsync.draining, sp_true);
+    atomic_store(&SafePrintAsync.running, sp_true);
+    if (thrd_create(&SafePrintAsync.thread, safe_print_async_thread, 0) != thrd_success) {
+        atomic_store(&SafePrintAsync.running, sp_false);
+        atomic_store(&SafePrintAsync.draining, sp_false);
+        cnd_destroy(&SafePrintAsync.wake);
+        mtx_destroy(&SafePrintAsync.wake_lock);
         return sp_false;
     }
     
     return sp_true;
 }
 
-enum {
-    SP_PFS_OK,
-    SP_PFS_ERROR,
-    SP_PFS_ESCAPED_BRACE
-};
-static sp_s32 safe_print_parse_format_specifier(SafePrintContext *context, SafePrintFormatInfo *out) {
-    SafePrintFormatInfo info = {0};
-    info.arg_index = -1;
+void safe_print_async_stop(void) {
+    if (!atomic_exchange(&SafePrintAsync.running, sp_false)) return;
     
-    SafePrintFormatToken opening_brace = safe_print_next_token(context);
-    if (opening_brace.kind != SP_FT_OPENING_BRACE) {
-        SAFE_PRINT_DEBUG_ERROR_LOCATION(context, opening_brace.location);
-        safe_print_report_error(context, SP_ERROR_UNKNOWN_FORMAT_SPECIFIER , "Implementation error. Wrong call to safe_print_parse_format_specifier.");
-        return SP_PFS_ERROR;
-    }
-    if (context->fmt[0] == '{') {
-        context->fmt += 1;
-        return SP_PFS_ESCAPED_BRACE;
+    safe_print_async_wake();
+    thrd_join(SafePrintAsync.thread, 0);
+    
+    cnd_destroy(&SafePrintAsync.wake);
+    mtx_destroy(&SafePrintAsync.wake_lock);
+}
+
+unsigned long long safe_print_async_dropped(void) {
+    return atomic_load_explicit(&SafePrintAsync.dropped, memory_order_relaxed);
+}
+
+int safe_print_async_implementation(SafePrintFileType handle, char const *fmt, SafePrintFormatArg const *args, int arg_count) {
+    if (arg_count > SAFE_PRINT_ASYNC_MAX_ARGS) return SP_ERROR_TOO_MANY_ARGUMENTS;
+    
+    // NOTE: Before safe_print_async_start and after safe_print_async_stop nobody takes records
+    //       out of the queue, so print right away. The consumer only quits once no producer
+    //       is counted in, see safe_print_async_thread.
+    atomic_fetch_add(&SafePrintAsync.producers, 1);
+    if (!atomic_load(&SafePrintAsync.running)) {
+        atomic_fetch_sub(&SafePrintAsync.producers, 1);
+        
+        // NOTE: Records of this thread could still be in the queue, they have to come out first.
+        while (atomic_load(&SafePrintAsync.draining)) thrd_yield();
+        return safe_print_implementation(handle, fmt, args, arg_count);
     }
     
-    SafePrintFormatToken token;
+    SafePrintAsyncRecord *record;
+    size_t position = atomic_load_explicit(&SafePrintAsync.enqueue_position, memory_order_relaxed);
     
-    if (context->fmt[0] != '}') {
-        do {
-            token = safe_print_next_token(context);
-            switch (token.kind) {
-                case SP_FT_NUMBER: {
-                    if (token.number < 0 || token.number > context->arg_count) {
-                        SAFE_PRINT_DEBUG_ERROR_LOCATION(context, token.location);
-                        safe_print_report_error(context, SP_ERROR_POSITIONAL_ARG_OUT_OF_RANGE , "Bad argument index.");
-                        return SP_PFS_ERROR;
-                    }
-                    info.arg_index = token.number - 1;
-                } break;
-                
-                case SP_FT_KEYWORD_MIN: {
-                    SafePrintFormatToken token;
-                    if (!safe_print_parse_format_function(context, &token))
-                        return SP_PFS_ERROR;
-                    
-                    if (token.kind != SP_FT_NUMBER) {
-                        SAFE_PRINT_DEBUG_ERROR_LOCATION(context, token.location);
-                        safe_print_report_error(context, SP_ERROR_UNKNOWN_FORMAT_SPECIFIER , "Expected number in min specifier.");
-                        return SP_PFS_ERROR;
-                    }
-                    info.min = token.number;
-                } break;
-                
-                case SP_FT_KEYWORD_MAX: {
-                    safe_print_consume_next_token(context, SP_FT_OPENING_PAREN, "Missing ( after max specifier.");
-                    SafePrintFormatToken token = safe_print_consume_next_token(context, SP_FT_NUMBER, "Expected number inside max specifier.");
-                    info.max = token.number;
-                    safe_print_consume_next_token(context, SP_FT_CLOSING_PAREN, "Missing ) after max specifier.");
-                } break;
-                
-                case SP_FT_KEYWORD_FILL: {
-                    safe_print_consume_next_token(context, SP_FT_OPENING_PAREN, "Missing ( after fill specifier.");
-                    info.fill = context->fmt[0];
-                    context->fmt += 1;
-                    safe_print_consume_next_token(context, SP_FT_CLOSING_PAREN, "Missing ) after fill specifier.");
-                } break;
-                
-                case SP_FT_KEYWORD_PREC: {
-                    safe_print_consume_next_token(context, SP_FT_OPENING_PAREN, "Missing ( after fill specifier.");
-                    SafePrintFormatToken token = safe_print_consume_next_token(context, SP_FT_NUMBER, "Expected number inside precision specifier.");
-                    info.precision = token.number;
-                    safe_print_consume_next_token(context, SP_FT_CLOSING_PAREN, "Missing ) after fill specifier.");
-                } break;
-                
-                case SP_FT_KEYWORD_LEFT: { info.alignment = SP_FI_ALIGN_LEFT; } break;
-                case SP_FT_KEYWORD_RIGHT: { info.alignment = SP_FI_ALIGN_RIGHT; } break;
-                
-                case SP_FT_KEYWORD_BASE: {
-                    safe_print_consume_next_token(context, SP_FT_OPENING_PAREN, "Missing ( after fill specifier.");
-                    SafePrintFormatToken token = safe_print_consume_next_token(context, SP_FT_NUMBER, "Expected number inside precision specifier.");
-                    info.base = token.number;
-                    safe_print_consume_next_token(context, SP_FT_CLOSING_PAREN, "Missing ) after fill specifier.");
-                } break;
-                
-                case SP_FT_KEYWORD_SCI: { info.scientific = sp_true; } break;
-                case SP_FT_KEYWORD_SIGN: { info.sign = sp_true; } break;
-                
-                case SP_FT_KEYWORD_LOWER: { info.char_case = SP_FI_LOWER_CASE; } break;
-                case SP_FT_KEYWORD_UPPER: { info.char_case = SP_FI_UPPER_CASE; } break;
-                
-                case SP_FT_BASE_BIN: { info.base = 2; } break;
-                case SP_FT_BASE_OCT: { info.base = 8; } break;
-                case SP_FT_BASE_DEC: { info.base = 10; } break;
-                case SP_FT_BASE_HEX: { info.base = 16; } break;
-                
-                case SP_FT_STRING: {
-                    SAFE_PRINT_DEBUG_ERROR_LOCATION(context, token.location);
-                    safe_print_report_error(context, SP_ERROR_UNKNOWN_FORMAT_SPECIFIER , "Unknown format specifier.");
-                    return SP_PFS_ERROR;
-                } break;
-                
-                case SP_FT_END_OF_INPUT: {
-                    SAFE_PRINT_DEBUG_ERROR_LOCATION(context, token.location);
-                    safe_print_report_error(context, SP_ERROR_MISSING_BRACE , "Reached end of format string, missing }.");
-                    return SP_PFS_ERROR;
-                } break;
+    for (;;) {
+        record = &SafePrintAsync.records[position & (SAFE_PRINT_ASYNC_QUEUE_SIZE - 1)];
+        size_t sequence = atomic_load_explicit(&record->sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+        
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&SafePrintAsync.enqueue_position, &position, position + 1, memory_order_relaxed, memory_order_relaxed)) break;
+        } else if (difference < 0) {
+            // NOTE: The queue is full.
+            if (SafePrintAsync.overflow_policy != SAFE_PRINT_ASYNC_BLOCK) {
+                if (SafePrintAsync.overflow_policy == SAFE_PRINT_ASYNC_COUNT_DROPS) {
+                    atomic_fetch_add_explicit(&SafePrintAsync.dropped, 1, memory_order_relaxed);
+                }
                 
-                case SP_FT_UNKOWN: {
-                    SAFE_PRINT_DEBUG_ERROR_LOCATION(context, opening_brace.location);
-                    safe_print_report_error(context, SP_ERROR_UNKNOWN_FORMAT_SPECIFIER , "Missing } in format specifier.");
-                    return SP_PFS_ERROR;
-                } break;
+                atomic_fetch_sub(&SafePrintAsync.producers, 1);
+                return SP_ERROR_QUEUE_FULL;
             }
             
-            token = safe_print_next_token(context);
-        } while (token.kind == SP_FT_SEPERATOR);
+            thrd_yield();
+            position = atomic_load_explicit(&SafePrintAsync.enqueue_position, memory_order_relaxed);
+        } else {
+            position = atomic_load_explicit(&SafePrintAsync.enqueue_position, memory_order_relaxed);
+        }
+    }
+    
+    record->file = handle;
+    record->fmt = fmt;
+    record->arg_count = arg_count;
+    memcpy(record->args, args, arg_count * sizeof(SafePrintFormatArg));
+    
+    // NOTE: Strings have to be copied as they could be gone by the time the record is printed.
+    //       Strings that don't fit into the remaining space of the record are truncated.
+    sp_s64 used = 0;
+    for (sp_s32 i = 0; i < record->arg_count; i += 1) {
+        SafePrintFormatArg *arg = &record->args[i];
+        if (arg->kind != SAFE_PRINT_STR && arg->kind != SAFE_PRINT_STR_REF) continue;
         
-    } else {
-        token = safe_print_next_token(context);
+        char const *str = arg->kind == SAFE_PRINT_STR ? arg->str : arg->str_ref.data;
+        sp_s64 space  = SAFE_PRINT_ASYNC_STRING_SPACE - used;
+        sp_s64 length = arg->kind == SAFE_PRINT_STR ? safe_print_cstring_length_bounded(str, space) : arg->str_ref.length;
+        if (space <= 0) {
+            *arg = safe_print_arg_str("");
+            continue;
+        }
+        if (length > space - 1) length = space - 1;
+        
+        char *copy = record->strings + used;
+        memcpy(copy, str, length);
+        copy[length] = '\0';
+        used += length + 1;
+        
+        if (arg->kind == SAFE_PRINT_STR) {
+            arg->str = copy;
+        } else {
+            arg->str_ref.data = copy;
+            arg->str_ref.length = (int)length;
+        }
+    }
+    
+    atomic_store(&record->sequence, position + 1);
+    
+    if (atomic_load(&SafePrintAsync.sleeping)) safe_print_async_wake();
+    atomic_fetch_sub(&SafePrintAsync.producers, 1);
+    
+    return 0;
+}
+
+#endif // defined(SAFE_PRINT_ASYNC)
+
+
+/*
+ * Binary log layout (native byte order):
+ *
+ * header:     'S' 'P' 'B' 'L'
+ * format:     'F', u32 id, u32 length, the format string including its terminating 0
+ * record:     'R', u32 format id, u8 arg count, per argument: u8 kind and the raw value
+ *             (4 bytes for I32/U32, 8 bytes for I64/U64/R64/PTR, u32 length and the
+ *             string including its terminating 0 for STR)
+ *
+ * A header resets the format ids, so logs of several runs can simply be appended.
+ */
+static void safe_print_push_u32(SafePrintContext *context, sp_u32 value) {
+    safe_print_push_string(context, (char const*)&value, sizeof(value));
+}
+
+// NOTE: Takes 8 bytes per step, only formats that miss the lookup by address are hashed.
+static sp_u32 safe_print_hash_string(char const *str, sp_s64 length) {
+    sp_u64 hash = (sp_u64)length * 0x9E3779B97F4A7C15ULL;
+    sp_s64 i = 0;
+    for (; i + 8 <= length; i += 8) {
+        sp_u64 word;
+        memcpy(&word, str + i, 8);
+        hash = (hash ^ word) * 0xFF51AFD7ED558CCDULL;
+        hash ^= hash >> 32;
+    }
+    
+    sp_u64 tail = 0;
+    memcpy(&tail, str + i, length - i);
+    hash = (hash ^ tail) * 0xFF51AFD7ED558CCDULL;
+    
+    return (sp_u32)(hash >> 32);
+}
+
+int safe_print_binary_open(SafePrintBinaryLog *log, SafePrintFileType file) {
+    log->file = file;
+    log->format_count = 0;
+    log->text_used = 0;
+    // NOTE: A length of 0 marks a free slot, stored lengths include the terminating 0.
+    for (sp_s32 i = 0; i < SAFE_PRINT_BINARY_MAX_FORMATS; i += 1) {
+        log->formats[i].length = 0;
+        log->recent[i].fmt = 0;
+    }
+    
+    SafePrintContext context = {0};
+    safe_print_init_file_context(&context, file, "");
+    safe_print_push_string(&context, "SPBL", 4);
+    safe_print_flush_buffer(&context);
+    
+    return context.error ? context.error : context.written;
+}
+
+int safe_print_binary_implementation(SafePrintBinaryLog *log, char const *fmt, SafePrintFormatArg const *args, int arg_count) {
+    // NOTE: The argument count of a record is a single byte.
+    if (arg_count > 255) return SP_ERROR_TOO_MANY_ARGUMENTS;
+    
+    SafePrintContext context = {0};
+    safe_print_init_file_context(&context, log->file, fmt);
+    context.args = args;
+    context.arg_count = arg_count;
+    
+    sp_u32 mask = SAFE_PRINT_BINARY_MAX_FORMATS - 1;
+    sp_u32 recent = safe_print_hash_pointer(fmt) & mask;
+    sp_s32 slot = -1;
+    
+    // NOTE: The format was used from the same address before. The buffer could have been
+    //       reused for another format, so the text is compared, but not measured or hashed.
+    if (log->recent[recent].fmt == fmt) {
+        sp_s32 candidate = log->recent[recent].slot;
+        if (strcmp(log->text + log->formats[candidate].text, fmt) == 0) slot = candidate;
+    }
+    
+    sp_u32 length = 0;
+    sp_u32 hash = 0;
+    sp_b32 is_new = sp_false;
+    if (slot < 0) {
+        length = (sp_u32)safe_print_cstring_length(fmt) + 1;
+        hash = safe_print_hash_string(fmt, length);
+        
+        slot = hash & mask;
+        sp_s32 probes = 0;
+        while (log->formats[slot].length) {
+            if (log->formats[slot].hash == hash && log->formats[slot].length == length &&
+                memcmp(log->text + log->formats[slot].text, fmt, length) == 0) break;
+            
+            probes += 1;
+            if (probes == SAFE_PRINT_BINARY_MAX_FORMATS) return SP_ERROR_TOO_MANY_FORMATS;
+            
+            slot = (slot + 1) & mask;
+        }
+        
+        is_new = !log->formats[slot].length;
+        if (is_new && length > (sp_u32)(SAFE_PRINT_BINARY_FORMAT_SPACE - log->text_used)) return SP_ERROR_TOO_MANY_FORMATS;
+    }
+    
+    // NOTE: A new format only gets its slot once its 'F' record was written, see below.
+    sp_s32 id = is_new ? log->format_count : log->formats[slot].id;
+    if (is_new) {
+        safe_print_push_character(&context, 'F');
+        safe_print_push_u32(&context, id);
+        safe_print_push_u32(&context, length);
+        safe_print_push_string(&context, fmt, length);
+    }
+    
+    safe_print_push_character(&context, 'R');
+    safe_print_push_u32(&context, id);
+    safe_print_push_character(&context, (char)context.arg_count);
+    
+    for (sp_s32 i = 0; i < context.arg_count; i += 1) {
+        SafePrintFormatArg const *arg = &context.args[i];
+        // NOTE: Sized strings are stored like every other string.
+        safe_print_push_character(&context, (char)(arg->kind == SAFE_PRINT_STR_REF ? SAFE_PRINT_STR : arg->kind));
+        
+        switch (arg->kind) {
+            case SAFE_PRINT_I32:
+            case SAFE_PRINT_U32:
+            case SAFE_PRINT_R32: {
+                safe_print_push_string(&context, (char const*)&arg->u32, 4);
+            } break;
+            
+            case SAFE_PRINT_I64:
+            case SAFE_PRINT_U64:
+            case SAFE_PRINT_R64: {
+                safe_print_push_string(&context, (char const*)&arg->u64, 8);
+            } break;
+            
+            case SAFE_PRINT_PTR: {
+                sp_u64 value = (uintptr_t)arg->ptr;
+                safe_print_push_string(&context, (char const*)&value, 8);
+            } break;
+            
+            case SAFE_PRINT_STR: {
+                sp_u32 length = (sp_u32)safe_print_cstring_length(arg->str) + 1;
+                safe_print_push_u32(&context, length);
+                safe_print_push_string(&context, arg->str, length);
+            } break;
+            
+            case SAFE_PRINT_STR_REF: {
+                safe_print_push_u32(&context, (sp_u32)arg->str_ref.length + 1);
+                safe_print_push_string(&context, arg->str_ref.data, arg->str_ref.length);
+                safe_print_push_character(&context, '\0');
+            } break;
+        }
+    }
+    
+    safe_print_flush_buffer(&context);
+    if (context.error) return context.error;
+    
+    // NOTE: Had the id been registered before a failed write, every later record would point
+    //       to a format the log doesn't contain. Now the next call simply writes it again.
+    if (is_new) {
+        memcpy(log->text + log->text_used, fmt, length);
+        log->formats[slot].hash = hash;
+        log->formats[slot].length = length;
+        log->formats[slot].text = log->text_used;
+        log->formats[slot].id = id;
+        log->text_used += length;
+        log->format_count += 1;
+    }
+    log->recent[recent].fmt = fmt;
+    log->recent[recent].slot = slot;
+    
+    return context.written;
+}
+
+typedef struct SafePrintBinaryReader {
+    char const *data;
+    size_t size;
+    size_t position;
+    sp_b32 error;
+} SafePrintBinaryReader;
+
+static void safe_print_binary_read(SafePrintBinaryReader *reader, void *out, size_t size) {
+    if (reader->size - reader->position < size) {
+        reader->error = sp_true;
+        memset(out, 0, size);
+        return;
     }
     
-    if (token.kind != SP_FT_CLOSING_BRACE) {
-        SAFE_PRINT_DEBUG_ERROR_LOCATION(context, opening_brace.location);
-        safe_print_report_error(context, SP_ERROR_MISSING_BRACE , "Missing } in format specifier.");
-        return SP_PFS_ERROR;
-    }
+    memcpy(out, reader->data + reader->position, size);
+    reader->position += size;
+}
+
+/*
+ * Returns a string that was stored including its terminating 0, pointing right into the data.
+ */
+static char const* safe_print_binary_read_string(SafePrintBinaryReader *reader) {
+    sp_u32 length;
+    safe_print_binary_read(reader, &length, 4);
     
-    if (info.arg_index == -1) {
-        info.arg_index = context->current_index;
-        if (info.arg_index == context->arg_count) {
-            SAFE_PRINT_DEBUG_ERROR_LOCATION(context, opening_brace.location);
-            safe_print_report_error(context, SP_ERROR_TOO_MANY_ARGUMENTS , "Not enough print arguments for this format specifier");
-            return SP_PFS_ERROR;
-        }
-        context->current_index += 1;
+    if (!length || reader->size - reader->position < length || reader->data[reader->position + length - 1] != '\0') {
+        reader->error = sp_true;
+        return "";
     }
     
-    *out = info;
-    return SP_PFS_OK;
+    char const *result = reader->data + reader->position;
+    reader->position += length;
+    
+    return result;
 }
 
-int safe_print_implementation(SafePrintFileType handle, char const *fmt, ...) {
+/*
+ * Returns how many arguments a format string uses, the highest argument index plus one,
+ * or -1 when it doesn't parse. The error is only reported once the format is used.
+ */
+static sp_s32 safe_print_format_arg_count(char const *fmt) {
     SafePrintContext context = {0};
     context.fmt_start = fmt;
     context.fmt = fmt;
-    context.file = handle;
+    context.target = SP_TARGET_MEMORY;
+    context.buffer = context.staging;
+    context.arg_count = INT32_MAX;
+    
+    sp_s32 arg_count = 0;
+    while (context.fmt[0]) {
+        if (context.fmt[0] == '{') {
+            SafePrintFormatInfo info;
+            sp_s32 status = safe_print_parse_format_specifier(&context, &info);
+            if (status == SP_PFS_ERROR) return -1;
+            if (status == SP_PFS_OK && info.arg_index >= arg_count) arg_count = info.arg_index + 1;
+        } else if (context.fmt[0] == '}') {
+            if (context.fmt[1] != '}') return -1;
+            context.fmt += 2;
+        } else {
+            context.fmt = safe_print_find_brace(context.fmt);
+        }
+    }
     
-    va_list args;
-    va_start(args, fmt);
+    return arg_count;
+}
+
+int safe_print_binary_decode(SafePrintFileType handle, void const *data, size_t size) {
+    SafePrintBinaryReader reader = {(char const*)data, size, 0, sp_false};
+    char const *formats[SAFE_PRINT_BINARY_MAX_FORMATS] = {0};
+    sp_s32 format_arg_counts[SAFE_PRINT_BINARY_MAX_FORMATS];
+    sp_s32 records = 0;
     
-    int arg_type = va_arg(args, int);
-    while (arg_type) {
-        SafePrintFormatArg arg = {0};
-        
-        int arg_kind = TypeLookupTable[arg_type];
+    while (reader.position < reader.size && !reader.error) {
+        char tag;
+        safe_print_binary_read(&reader, &tag, 1);
         
-        switch (arg_kind) {
-            case SAFE_PRINT_I32: {
-                arg.kind = SAFE_PRINT_I32;
-                arg.s32 = va_arg(args, sp_s32);
-            } break;
-            
-            case SAFE_PRINT_U32: {
-                arg.kind = SAFE_PRINT_U32;
-                arg.u32 = va_arg(args, sp_u32);
-            } break;
-            
-            case SAFE_PRINT_I64: {
-                arg.kind = SAFE_PRINT_I64;
-                arg.s64 = va_arg(args, sp_s64);
-            } break;
-            
-            case SAFE_PRINT_U64: {
-                arg.kind = SAFE_PRINT_U64;
-                arg.u64 = va_arg(args, sp_u64);
+        switch (tag) {
+            case 'S': {
+                char magic[3];
+                safe_print_binary_read(&reader, magic, 3);
+                if (magic[0] != 'P' || magic[1] != 'B' || magic[2] != 'L') reader.error = sp_true;
+                
+                for (sp_s32 i = 0; i < SAFE_PRINT_BINARY_MAX_FORMATS; i += 1) formats[i] = 0;
             } break;
             
-            case SAFE_PRINT_R64: {
-                arg.kind = SAFE_PRINT_R64;
-                arg.r64 = va_arg(args, sp_r64);
+            case 'F': {
+                sp_u32 id;
+                safe_print_binary_read(&reader, &id, 4);
+                char const *fmt = safe_print_binary_read_string(&reader);
+                
+                if (id >= SAFE_PRINT_BINARY_MAX_FORMATS) {
+                    reader.error = sp_true;
+                } else {
+                    formats[id] = fmt;
+                    format_arg_counts[id] = safe_print_format_arg_count(fmt);
+                }
             } break;
             
-            case SAFE_PRINT_STR: {
-                arg.kind = SAFE_PRINT_STR;
-                arg.str = va_arg(args, char const*);
+            case 'R': {
+                sp_u32 id;
+                unsigned char arg_count;
+                safe_print_binary_read(&reader, &id, 4);
+                safe_print_binary_read(&reader, &arg_count, 1);
+                
+                if (id >= SAFE_PRINT_BINARY_MAX_FORMATS || !formats[id]) {
+                    reader.error = sp_true;
+                    break;
+                }
+                
+                SafePrintFormatArg args[255];
+                SafePrintContext context = {0};
+                safe_print_init_file_context(&context, handle, formats[id]);
+                context.args = args;
+                context.arg_count = arg_count;
+                
+                for (sp_s32 i = 0; i < arg_count; i += 1) {
+                    SafePrintFormatArg *arg = &args[i];
+                    unsigned char kind;
+                    safe_print_binary_read(&reader, &kind, 1);
+                    arg->kind = kind;
+                    
+                    switch (kind) {
+                        case SAFE_PRINT_I32:
+                        case SAFE_PRINT_U32:
+                        case SAFE_PRINT_R32: {
+                            safe_print_binary_read(&reader, &arg->u32, 4);
+                        } break;
+                        
+                        case SAFE_PRINT_I64:
+                        case SAFE_PRINT_U64:
+                        case SAFE_PRINT_R64: {
+                            safe_print_binary_read(&reader, &arg->u64, 8);
+                        } break;
+                        
+                        case SAFE_PRINT_PTR: {
+                            sp_u64 value;
+                            safe_print_binary_read(&reader, &value, 8);
+                            arg->ptr = (void const*)(uintptr_t)value;
+                        } break;
+                        
+                        case SAFE_PRINT_STR: {
+                            arg->str = safe_print_binary_read_string(&reader);
+                        } break;
+                        
+                        default: {
+                            reader.error = sp_true;
+                        } break;
+                    }
+                }
+                if (reader.error) break;
+                
+                // NOTE: Arguments the format doesn't use would be dropped without a word.
+                if (format_arg_counts[id] >= 0 && format_arg_counts[id] != arg_count) return SP_ERROR_ARGUMENT_COUNT_MISMATCH;
+                
+                sp_s32 result = safe_print_format(&context);
+                if (result < 0) return result;
+                
+                records += 1;
             } break;
             
-            case SAFE_PRINT_PTR: {
-                arg.kind = SAFE_PRINT_PTR;
-                arg.ptr = va_arg(args, void const*);
+            default: {
+                reader.error = sp_true;
             } break;
         }
-        
-        context.args[context.arg_count] = arg;
-        context.arg_count += 1;
-        
-        arg_type = va_arg(args, int);
     }
     
-    va_end(args);
+    if (reader.error) return SP_ERROR_CORRUPT_BINARY_LOG;
     
-    while (context.fmt[0]) {
-        if (context.error) return context.error;
+    return records;
+}
+
+
+#if defined(SAFE_PRINT_FLIGHT_RECORDER)
+
+/*
+ * Flight recorder:
+ *
+ * The region starts with a SafePrintRecorderHeader, the rest is a ring of records. A writer
+ * reserves the space of its record with a fetch-add on the number of bytes ever reserved,
+ * which is also the position of the record. Every record starts with a SafePrintRecordHeader
+ * on a 16 byte boundary, so a header never wraps around the end of the ring, only the text
+ * after it can. The position in the record header is stored last. A reader only trusts a
+ * header that holds its own position, so records that were overwritten in the meantime
+ * or never finished, because the process died while writing them, are skipped.
+ * A writer that is overtaken by a whole lap of the ring while it copies its text garbles
+ * the newer record at that place, so the ring has to be a lot larger than what all threads
+ * write in that time.
+ */
+#define SAFE_PRINT_RECORDER_MAGIC   0x52465053u // "SPFR"
+#define SAFE_PRINT_RECORD_MAGIC     0x44524352u // "RCRD"
+#define SAFE_PRINT_RECORDER_HEADER_SIZE 64
+
+typedef struct SafePrintRecorderHeader {
+    sp_u32 magic;
+    sp_u32 header_size;
+    sp_u64 ring_size;
+    _Atomic sp_u64 position;
+} SafePrintRecorderHeader;
+
+typedef struct SafePrintRecordHeader {
+    _Atomic sp_u64 position;
+    sp_u32 length;
+    sp_u32 magic;
+} SafePrintRecordHeader;
+
+static sp_u64 safe_print_record_size(sp_u64 length) {
+    return (sizeof(SafePrintRecordHeader) + length + 15) & ~(sp_u64)15;
+}
+
+/*
+ * A region that already holds a recorder of the same size keeps its records and the new ones
+ * continue after them, everything else is cleared first.
+ */
+int safe_print_recorder_attach(SafePrintFlightRecorder *recorder, void *memory, size_t size) {
+    // NOTE: A recorder that failed to open stays empty and calls on it return SP_ERROR_RECORDER_NOT_OPEN.
+    recorder->memory = 0;
+    recorder->size = 0;
+    recorder->mapped = sp_false;
+    
+    if (size < SAFE_PRINT_RECORDER_HEADER_SIZE + safe_print_record_size(SAFE_PRINT_RECORDER_MAX_RECORD)) return 0;
+    
+    SafePrintRecorderHeader *header = (SafePrintRecorderHeader*)memory;
+    sp_u64 ring_size = (size - SAFE_PRINT_RECORDER_HEADER_SIZE) & ~(sp_u64)15;
+    
+    if (header->magic != SAFE_PRINT_RECORDER_MAGIC || header->header_size != SAFE_PRINT_RECORDER_HEADER_SIZE || header->ring_size != ring_size) {
+        memset(memory, 0, size);
+        header->header_size = SAFE_PRINT_RECORDER_HEADER_SIZE;
+        header->ring_size = ring_size;
+        atomic_store(&header->position, 0);
+        header->magic = SAFE_PRINT_RECORDER_MAGIC;
+    }
+    
+    recorder->memory = memory;
+    recorder->size = size;
+    recorder->mapped = sp_false;
+    
+    return 1;
+}
+
+int safe_print_recorder_open(SafePrintFlightRecorder *recorder, char const *path, size_t size) {
+    recorder->memory = 0;
+    recorder->size = 0;
+    recorder->mapped = sp_false;
+    
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return 0;
+    
+    if (ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        return 0;
+    }
+    
+    // NOTE: The mapping stays valid after the descriptor is closed.
+    void *memory = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) return 0;
+    
+    if (!safe_print_recorder_attach(recorder, memory, size)) {
+        munmap(memory, size);
+        return 0;
+    }
+    recorder->mapped = sp_true;
+    
+    return 1;
+}
+
+void safe_print_recorder_close(SafePrintFlightRecorder *recorder) {
+    if (recorder->mapped) munmap(recorder->memory, recorder->size);
+    
+    recorder->memory = 0;
+    recorder->size = 0;
+    recorder->mapped = sp_false;
+}
+
+int safe_print_recorder_implementation(SafePrintFlightRecorder *recorder, char const *fmt, SafePrintFormatArg const *args, int arg_count) {
+    if (!recorder->memory) return SP_ERROR_RECORDER_NOT_OPEN;
+    
+    char text[SAFE_PRINT_RECORDER_MAX_RECORD + 1];
+    sp_s32 length = safe_print_buffer_implementation(text, sizeof(text), fmt, args, arg_count);
+    if (length < 0) return length;
+    if (length > SAFE_PRINT_RECORDER_MAX_RECORD) length = SAFE_PRINT_RECORDER_MAX_RECORD;
+    
+    SafePrintRecorderHeader *header = (SafePrintRecorderHeader*)recorder->memory;
+    char *ring = (char*)recorder->memory + SAFE_PRINT_RECORDER_HEADER_SIZE;
+    sp_u64 ring_size = header->ring_size;
+    
+    sp_u64 position = atomic_fetch_add_explicit(&header->position, safe_print_record_size(length), memory_order_relaxed);
+    sp_u64 offset = position % ring_size;
+    
+    sp_u64 start = (offset + sizeof(SafePrintRecordHeader)) % ring_size;
+    sp_u64 first = ring_size - start < (sp_u64)length ? ring_size - start : (sp_u64)length;
+    memcpy(ring + start, text, first);
+    memcpy(ring, text + first, length - first);
+    
+    SafePrintRecordHeader *record = (SafePrintRecordHeader*)(ring + offset);
+    record->length = length;
+    record->magic = SAFE_PRINT_RECORD_MAGIC;
+    atomic_store_explicit(&record->position, position, memory_order_release);
+    
+    return length;
+}
+
+/*
+ * Prints the records that are still in the ring, oldest first. data is the whole region,
+ * e.g. the content of the file after the process is gone.
+ */
+int safe_print_recorder_dump(SafePrintFileType handle, void const *data, size_t size) {
+    if (size < SAFE_PRINT_RECORDER_HEADER_SIZE) return SP_ERROR_CORRUPT_RECORDER;
+    
+    SafePrintRecorderHeader const *header = (SafePrintRecorderHeader const*)data;
+    char const *ring = (char const*)data + SAFE_PRINT_RECORDER_HEADER_SIZE;
+    sp_u64 ring_size = header->ring_size;
+    if (header->magic != SAFE_PRINT_RECORDER_MAGIC || header->header_size != SAFE_PRINT_RECORDER_HEADER_SIZE) return SP_ERROR_CORRUPT_RECORDER;
+    if (ring_size == 0 || ring_size % 16 || ring_size > size - SAFE_PRINT_RECORDER_HEADER_SIZE) return SP_ERROR_CORRUPT_RECORDER;
+    
+    sp_u64 end = atomic_load_explicit((_Atomic sp_u64*)&header->position, memory_order_acquire);
+    if (end % 16) return SP_ERROR_CORRUPT_RECORDER;
+    
+    sp_u64 position = end > ring_size ? end - ring_size : 0;
+    
+    SafePrintContext context = {0};
+    safe_print_init_file_context(&context, handle, "");
+    
+    sp_s32 records = 0;
+    while (position < end) {
+        SafePrintRecordHeader const *record = (SafePrintRecordHeader const*)(ring + position % ring_size);
+        sp_u64 record_position = atomic_load_explicit((_Atomic sp_u64*)&record->position, memory_order_acquire);
         
-        if (context.fmt[0] == '{') {
-            SafePrintFormatInfo info;
-            sp_s32 status = safe_print_parse_format_specifier(&context, &info);
-            if (status == SP_PFS_ERROR) {
-                return SP_ERROR_UNKNOWN_FORMAT_SPECIFIER ;
-            } else if (status == SP_PFS_ESCAPED_BRACE) {
-                safe_print_output_character(&context, '{');
-            } else {
-                safe_print_format_arg(&context, info);
-            }
-        } else if (context.fmt[0] == '}') {
-            if (context.fmt[1] == '}') {
-                safe_print_output_character(&context, '}');
-                context.fmt += 2;
-            } else {
-                SAFE_PRINT_DEBUG_ERROR_LOCATION(&context, context.fmt - context.fmt_start);
-                safe_print_report_error(&context, SP_ERROR_MISSING_BRACE , "stray } in format string.");
-                context.fmt += 1;
-            }
-        } else {
-            safe_print_output_character(&context, context.fmt[0]);
-            context.fmt += 1;
+        if (record_position != position || record->magic != SAFE_PRINT_RECORD_MAGIC || position + safe_print_record_size(record->length) > end) {
+            position += 16;
+            continue;
         }
+        
+        sp_u64 start = (position % ring_size + sizeof(SafePrintRecordHeader)) % ring_size;
+        sp_u64 first = ring_size - start < record->length ? ring_size - start : record->length;
+        safe_print_push_string(&context, ring + start, first);
+        safe_print_push_string(&context, ring, record->length - first);
+        
+        position += safe_print_record_size(record->length);
+        records += 1;
     }
     
-    return context.written;
+    safe_print_flush_buffer(&context);
+    if (context.error) return context.error;
+    
+    return records;
 }
 
+#endif // defined(SAFE_PRINT_FLIGHT_RECORDER)
+
 
 
 /**********************************************************************************************************************
@@ -1297,19 +4331,6 @@ int safe_print_implementation(SafePrintFileType handle, char const *fmt, ...) {
 
 
 
-static struct
-{
-    short temp; // force next field to be 2-byte aligned
-    char pair[201];
-} stbsp__digitpair =
-{
-    0,
-    "00010203040506070809101112131415161718192021222324"
-        "25262728293031323334353637383940414243444546474849"
-        "50515253545556575859606162636465666768697071727374"
-        "75767778798081828384858687888990919293949596979899"
-};
-
 // copies d to bits w/ strict aliasing (this compiles to nothing on /Ox)
 #define STBSP__COPYFP(dest, src)			\
 {							\
@@ -1677,9 +4698,700 @@ static stbsp__int32 stbsp__real_to_str(char const **start, stbsp__uint32 *len, c
 
 #endif // !defined(SAFE_PRINT_USE_OWN_FLOAT_CONVERSION)
 
-#ifdef __cplusplus
+
+/**********************************************************************************************************************
+ *
+ * Shortest round trip conversion for doubles, following Ulf Adams' Ryu algorithm:
+ * "Ryu: fast float-to-string conversion", PLDI 2018. https://github.com/ulfjack/ryu
+ *
+ * It finds the decimal number with the fewest digits that still reads back as the same double, using
+ * only 64 and 128 bit integer math. The tables hold 5^i and 2^k / 5^q with 125 significant bits,
+ * they were generated with arbitrary precision integers.
+ *
+ *********************************************************************************************************************/
+
+
+#if !defined(SAFE_PRINT_USE_OWN_FLOAT_CONVERSION)
+
+#define SAFE_PRINT_POW5_INV_BITCOUNT 125
+#define SAFE_PRINT_POW5_BITCOUNT 125
+
+static sp_u64 const SafePrintPow5InvSplit[342][2] = {
+    { 0x0000000000000001ULL, 0x2000000000000000ULL }, { 0x999999999999999AULL, 0x1999999999999999ULL },
+    { 0x47AE147AE147AE15ULL, 0x147AE147AE147AE1ULL }, { 0x6C8B4395810624DEULL, 0x10624DD2F1A9FBE7ULL },
+    { 0x7A786C226809D496ULL, 0x1A36E2EB1C432CA5ULL }, { 0x61F9F01B866E43ABULL, 0x14F8B588E368F084ULL },
+    { 0xB4C7F34938583622ULL, 0x10C6F7A0B5ED8D36ULL }, { 0x87A6520EC08D236AULL, 0x1AD7F29ABCAF4857ULL },
+    { 0x9FB841A566D74F88ULL, 0x15798EE2308C39DFULL }, { 0xE62D01511F12A607ULL, 0x112E0BE826D694B2ULL },
+    { 0xD6AE6881CB5109A4ULL, 0x1B7CDFD9D7BDBAB7ULL }, { 0xDEF1ED34A2A73AEAULL, 0x15FD7FE17964955FULL },
+    { 0x7F27F0F6E885C8BBULL, 0x119799812DEA1119ULL }, { 0x650CB4BE40D60DF8ULL, 0x1C25C268497681C2ULL },
+    { 0xEA70909833DE7193ULL, 0x16849B86A12B9B01ULL }, { 0x21F3A6E0297EC143ULL, 0x1203AF9EE756159BULL },
+    { 0x6985D7CD0F313537ULL, 0x1CD2B297D889BC2BULL }, { 0x2137DFD73F5A90F9ULL, 0x170EF54646D49689ULL },
+    { 0xE75FE645CC4873FAULL, 0x12725DD1D243ABA0ULL }, { 0xA5663D3C7A0D865DULL, 0x1D83C94FB6D2AC34ULL },
+    { 0x511E976394D79EB1ULL, 0x179CA10C9242235DULL }, { 0xDA7EDF82DD794BC1ULL, 0x12E3B40A0E9B4F7DULL },
+    { 0x2A6498D1625BAC68ULL, 0x1E392010175EE596ULL }, { 0xEEB6E0A781E2F053ULL, 0x182DB34012B25144ULL },
+    { 0x58924D52CE4F26A9ULL, 0x1357C299A88EA76AULL }, { 0x27507BB7B07EA441ULL, 0x1EF2D0F5DA7DD8AAULL },
+    { 0x52A6C95FC0655034ULL, 0x18C240C4AECB13BBULL }, { 0x0EEBD44C99EAA690ULL, 0x13CE9A36F23C0FC9ULL },
+    { 0xB17953ADC3110A80ULL, 0x1FB0F6BE50601941ULL }, { 0xC12DDC8B02740867ULL, 0x195A5EFEA6B34767ULL },
+    { 0x3424B06F3529A052ULL, 0x14484BFEEBC29F86ULL }, { 0x901D59F290EE19DBULL, 0x1039D66589687F9EULL },
+    { 0x4CFBC31DB4B0295FULL, 0x19F623D5A8A73297ULL }, { 0x3D9635B15D59BAB2ULL, 0x14C4E977BA1F5BACULL },
+    { 0x97AB5E277DE16228ULL, 0x109D8792FB4C4956ULL }, { 0xF2ABC9D8C9689D0DULL, 0x1A95A5B7F87A0EF0ULL },
+    { 0x5BBCA17A3ABA173EULL, 0x154484932D2E725AULL }, { 0xAFCA1AC82EFB45CBULL, 0x11039D428A8B8EAEULL },
+    { 0xB2DCF7A6B1920945ULL, 0x1B38FB9DAA78E44AULL }, { 0xF57D92EBC141A104ULL, 0x15C72FB1552D836EULL },
+    { 0xC46475896767B403ULL, 0x116C262777579C58ULL }, { 0x6D6D88DBD8A5ECD2ULL, 0x1BE03D0BF225C6F4ULL },
+    { 0x8ABE071646EB23DBULL, 0x164CFDA3281E38C3ULL }, { 0x6EFE6C11D255B649ULL, 0x11D7314F534B609CULL },
+    { 0xB197134FB6EF8A0EULL, 0x1C8B821885456760ULL }, { 0x27AC0F72F8BFA1A5ULL, 0x16D601AD376AB91AULL },
+    { 0xB95672C260994E1EULL, 0x1244CE242C5560E1ULL }, { 0xF5571E03CDC21695ULL, 0x1D3AE36D13BBCE35ULL },
+    { 0x2AAC18030B01ABABULL, 0x17624F8A762FD82BULL }, { 0xBBBCE0026F348956ULL, 0x12B50C6EC4F31355ULL },
+    { 0x92C7CCD0B1EDA889ULL, 0x1DEE7A4AD4B81EEFULL }, { 0xDBD30A408E57BA07ULL, 0x17F1FB6F10934BF2ULL },
+    { 0x7CA8D50071DFC806ULL, 0x1327FC58DA0F6FF5ULL }, { 0xFAA7BB33E9660CD6ULL, 0x1EA6608E29B24CBBULL },
+    { 0x9552FC298784D711ULL, 0x18851A0B548EA3C9ULL }, { 0xAAA8C9BAD2D0AC0EULL, 0x139DAE6F76D88307ULL },
+    { 0xDDDADC5E1E1AACE3ULL, 0x1F62B0B257C0D1A5ULL }, { 0x7E48B04B4B488A4FULL, 0x191BC08EAC9A4151ULL },
+    { 0xCB6D59D5D5D3A1D9ULL, 0x141633A556E1CDDAULL }, { 0x3C577B1177DC817BULL, 0x1011C2EAABE7D7E2ULL },
+    { 0xC6F25E825960CF2AULL, 0x19B604AAACA62636ULL }, { 0x6BF518684780A5BBULL, 0x14919D5556EB51C5ULL },
+    { 0x232A79ED06008496ULL, 0x10747DDDDF22A7D1ULL }, { 0xD1DD8FE1A3340756ULL, 0x1A53FC9631D10C81ULL },
+    { 0xA7E4731AE8F66C45ULL, 0x150FFD44F4A73D34ULL }, { 0x531D28E253F8569EULL, 0x10D9976A5D52975DULL },
+    { 0xEB61DB03B98D5762ULL, 0x1AF5BF109550F22EULL }, { 0xBC4E48CFC7A445E8ULL, 0x159165A6DDDA5B58ULL },
+    { 0x6371D3D96C836B20ULL, 0x11411E1F17E1E2ADULL }, { 0x9F1C8628AD9F11CDULL, 0x1B9B6364F3030448ULL },
+    { 0xE5B06B53BE18DB0BULL, 0x1615E91D8F359D06ULL }, { 0xEAF3890FCB4715A2ULL, 0x11AB20E472914A6BULL },
+    { 0x44B8DB4C7871BC37ULL, 0x1C45016D841BAA46ULL }, { 0x03C715D6C6C1635FULL, 0x169D9ABE03495505ULL },
+    { 0x3638DE456BCDE919ULL, 0x1217AEFE69077737ULL }, { 0x56C163A2461641C1ULL, 0x1CF2B1970E725858ULL },
+    { 0xDF011C81D1AB67CEULL, 0x17288E1271F51379ULL }, { 0x7F3416CE4155ECA5ULL, 0x1286D80EC190DC61ULL },
+    { 0x6520247D3556476EULL, 0x1DA48CE468E7C702ULL }, { 0xEA801D30F7783925ULL, 0x17B6D71D20B96C01ULL },
+    { 0xBB99B0F3F92CFA84ULL, 0x12F8AC174D612334ULL }, { 0x5F5C4E532847F739ULL, 0x1E5AACF215683854ULL },
+    { 0x7F7D0B75B9D32C2EULL, 0x18488A5B44536043ULL }, { 0x9930D5F7C7DC2358ULL, 0x136D3B7C36A919CFULL },
+    { 0x8EB4898C72F9D226ULL, 0x1F152BF9F10E8FB2ULL }, { 0x722A07A38F2E41B8ULL, 0x18DDBCC7F40BA628ULL },
+    { 0xC1BB394FA5BE9AFAULL, 0x13E497065CD61E86ULL }, { 0x9C5EC2190930F7F6ULL, 0x1FD424D6FAF030D7ULL },
+    { 0x49E56814075A5FF8ULL, 0x197683DF2F268D79ULL }, { 0x6E51201005E1E660ULL, 0x145ECFE5BF520AC7ULL },
+    { 0xF1DA800CD181851AULL, 0x104BD984990E6F05ULL }, { 0x4FC400148268D4F5ULL, 0x1A12F5A0F4E3E4D6ULL },
+    { 0xD96999AA01ED772BULL, 0x14DBF7B3F71CB711ULL }, { 0xADEE1488018AC5BCULL, 0x10AFF95CC5B09274ULL },
+    { 0x497CEDA668DE092CULL, 0x1AB328946F80EA54ULL }, { 0x3ACA57B853E4D424ULL, 0x155C2076BF9A5510ULL },
+    { 0x623B7960431D7683ULL, 0x1116805EFFAEAA73ULL }, { 0x9D2BF566D1C8BD9EULL, 0x1B5733CB32B110B8ULL },
+    { 0x7DBCC452416D647FULL, 0x15DF5CA28EF40D60ULL }, { 0xCAFD69DB678AB6CCULL, 0x117F7D4ED8C33DE6ULL },
+    { 0xAB2F0FC572778ADFULL, 0x1BFF2EE48E052FD7ULL }, { 0x88F273045B92D580ULL, 0x1665BF1D3E6A8CACULL },
+    { 0xD3F528D049424466ULL, 0x11EAFF4A98553D56ULL }, { 0xB988414D4203A0A3ULL, 0x1CAB3210F3BB9557ULL },
+    { 0x6139CDD76802E6E9ULL, 0x16EF5B40C2FC7779ULL }, { 0xE761717920025254ULL, 0x125915CD68C9F92DULL },
+    { 0xA568B58E999D5086ULL, 0x1D5B561574765B7CULL }, { 0x5120913EE14AA6D2ULL, 0x177C44DDF6C515FDULL },
+    { 0xA74D40FF1AA21F0EULL, 0x12C9D0B1923744CAULL }, { 0x0BAECE64F769CB4AULL, 0x1E0FB44F50586E11ULL },
+    { 0x3C8BD850C5EE3C3BULL, 0x180C903F7379F1A7ULL }, { 0xCA0979DA37F1C9C9ULL, 0x133D4032C2C7F485ULL },
+    { 0xA9A8C2F6BFE942DBULL, 0x1EC866B79E0CBA6FULL }, { 0x2153CF2BCCBA9BE3ULL, 0x18A0522C7E709526ULL },
+    { 0x1AA9728970954982ULL, 0x13B374F06526DDB8ULL }, { 0xF775840F1A88759DULL, 0x1F8587E7083E2F8CULL },
+    { 0x5F9136727BA05E17ULL, 0x19379FEC0698260AULL }, { 0x1940F85B9619E4DFULL, 0x142C7FF0054684D5ULL },
+    { 0xE100C6AFAB47EA4CULL, 0x1023998CD1053710ULL }, { 0xCE67A44C453FDD47ULL, 0x19D28F47B4D524E7ULL },
+    { 0xD852E9D69DCCB106ULL, 0x14A8729FC3DDB71FULL }, { 0x79DBEE454B0A2738ULL, 0x1086C219697E2C19ULL },
+    { 0x295FE3A211A9D859ULL, 0x1A71368F0F30468FULL }, { 0xBAB31C81A7BB137AULL, 0x15275ED8D8F36BA5ULL },
+    { 0x6228E39AEC95A92FULL, 0x10EC4BE0AD8F8951ULL }, { 0x9D0E38F7E0EF7517ULL, 0x1B13AC9AAF4C0EE8ULL },
+    { 0xB0D82D931A592A79ULL, 0x15A956E225D67253ULL }, { 0x8D79BE0F4847552EULL, 0x11544581B7DEC1DCULL },
+    { 0x158F967EDA0BBB7CULL, 0x1BBA08CF8C979C94ULL }, { 0x77A611FF14D62F97ULL, 0x162E6D72D6DFB076ULL },
+    { 0xF951A7FF43DE8C79ULL, 0x11BEBDF578B2F391ULL }, { 0xC21C3FFED2FDAD8EULL, 0x1C6463225AB7EC1CULL },
+    { 0x01B0333242648AD8ULL, 0x16B6B5B5155FF017ULL }, { 0x0159C28E9B83A246ULL, 0x122BC490DDE659ACULL },
+    { 0xCEF604175F3903A3ULL, 0x1D12D41AFCA3C2ACULL }, { 0x725E69AC4C2D9C83ULL, 0x17424348CA1C9BBDULL },
+    { 0xF5185489D68AE39CULL, 0x129B69070816E2FDULL }, { 0xEE8D540FBDAB05C6ULL, 0x1DC574D80CF16B2FULL },
+    { 0xBED77672FE226B05ULL, 0x17D12A4670C1228CULL }, { 0xFF12C528CB4EBC04ULL, 0x130DBB6B8D674ED6ULL },
+    { 0xCB513B74787DF9A0ULL, 0x1E7C5F127BD87E24ULL }, { 0x090DC929F9FE614DULL, 0x18637F41FCAD31B7ULL },
+    { 0xA0D7D42194CB810AULL, 0x1382CC34CA2427C5ULL }, { 0x67BFB9CF5478CE77ULL, 0x1F37AD21436D0C6FULL },
+    { 0x1FCC94A5DD2D71F9ULL, 0x18F9574DCF8A7059ULL }, { 0x7FD6DD517DBDF4C7ULL, 0x13FAAC3E3FA1F37AULL },
+    { 0xFFBE2EE8C92FEE0BULL, 0x1FF779FD329CB8C3ULL }, { 0x6631BF20A0F324D6ULL, 0x1992C7FDC216FA36ULL },
+    { 0xB827CC1A1A5C1D78ULL, 0x14756CCB01ABFB5EULL }, { 0x935309AE7B7CE460ULL, 0x105DF0A267BCC918ULL },
+    { 0x1EEB42B0C594A099ULL, 0x1A2FE76A3F9474F4ULL }, { 0xE58902270476E6E1ULL, 0x14F31F8832DD2A5CULL },
+    { 0xB7A0CE859D2BEBE7ULL, 0x10C27FA028B0EEB0ULL }, { 0x59014A6F61DFDFD8ULL, 0x1AD0CC33744E4AB4ULL },
+    { 0xE0CDD525E7E64CADULL, 0x1573D68F903EA229ULL }, { 0x4D7177518651D6F1ULL, 0x11297872D9CBB4EEULL },
+    { 0x7BE8BEE8D6E957E8ULL, 0x1B758D848FAC54B0ULL }, { 0xFCBA3253DF211320ULL, 0x15F7A46A0C89DD59ULL },
+    { 0x63C8284318E74280ULL, 0x1192E9EE706E4AAEULL }, { 0x060D0D3827D86A66ULL, 0x1C1E43171A4A1117ULL },
+    { 0x6B3DA42CECAD21EBULL, 0x167E9C127B6E7412ULL }, { 0x88FE1CF0BD574E56ULL, 0x11FEE341FC585CDBULL },
+    { 0x419694B462254A23ULL, 0x1CCB0536608D615FULL }, { 0x67ABAA29E81DD4E9ULL, 0x1708D0F84D3DE77FULL },
+    { 0xB95621BB2017DD87ULL, 0x126D73F9D764B932ULL }, { 0xC223692B668C95A5ULL, 0x1D7BECC2F23AC1EAULL },
+    { 0xCE82BA891ED6DE1DULL, 0x179657025B6234BBULL }, { 0xA53562074BDF1818ULL, 0x12DEAC01E2B4F6FCULL },
+    { 0x3B889CD87964F359ULL, 0x1E3113363787F194ULL }, { 0xFC6D4A46C783F5E1ULL, 0x18274291C6065ADCULL },
+    { 0x30576E9F06032B1AULL, 0x13529BA7D19EAF17ULL }, { 0x1A257DCB3CD1DE90ULL, 0x1EEA92A61C311825ULL },
+    { 0x481DFE3C30A7E540ULL, 0x18BBA884E35A79B7ULL }, { 0xD34B31C9C0865100ULL, 0x13C9539D82AEC7C5ULL },
+    { 0x5211E942CDA3B4CDULL, 0x1FA885C8D117A609ULL }, { 0x74DB21023E1C90A4ULL, 0x19539E3A40DFB807ULL },
+    { 0xF715B401CB4A0D50ULL, 0x1442E4FB67196005ULL }, { 0xF8DE299B09080AA7ULL, 0x103583FC527AB337ULL },
+    { 0x8E304291A80CDDD7ULL, 0x19EF3993B72AB859ULL }, { 0x3E8D020E200A4B13ULL, 0x14BF6142F8EEF9E1ULL },
+    { 0x653D9B3E80083C0FULL, 0x10991A9BFA58C7E7ULL }, { 0x6EC8F864000D2CE4ULL, 0x1A8E90F9908E0CA5ULL },
+    { 0x8BD3F9E999A423EAULL, 0x153EDA614071A3B7ULL }, { 0x3CA994BAE1501CBBULL, 0x10FF151A99F482F9ULL },
+    { 0xC775BAC49BB3612BULL, 0x1B31BB5DC320D18EULL }, { 0xD2C4956A16291A89ULL, 0x15C162B168E70E0BULL },
+    { 0xDBD0778811BA7BA1ULL, 0x11678227871F3E6FULL }, { 0x2C80BF401C5D929BULL, 0x1BD8D03F3E9863E6ULL },
+    { 0xBD33CC3349E47549ULL, 0x16470CFF6546B651ULL }, { 0xCA8FD68F6E505DD4ULL, 0x11D270CC51055EA7ULL },
+    { 0x4419574BE3B3C953ULL, 0x1C83E7AD4E6EFDD9ULL }, { 0x0347790982F63AA9ULL, 0x16CFEC8AA52597E1ULL },
+    { 0xCF6C60D468C4FBBAULL, 0x123FF06EEA847980ULL }, { 0xE57A34870E07F92AULL, 0x1D331A4B10D3F59AULL },
+    { 0x512E906C0B399422ULL, 0x175C1508DA432AE2ULL }, { 0xDA8BA6BCD5C7A9B5ULL, 0x12B010D3E1CF5581ULL },
+    { 0x90DF712E22D90F87ULL, 0x1DE6815302E5559CULL }, { 0xDA4C5A8B4F140C6CULL, 0x17EB9AA8CF1DDE16ULL },
+    { 0xAEA37BA2A5A9A38AULL, 0x1322E220A5B17E78ULL }, { 0x7DD25F6AA2A905A9ULL, 0x1E9E369AA2B59727ULL },
+    { 0x97DB7F888220D154ULL, 0x187E92154EF7AC1FULL }, { 0x797C6606CE80A777ULL, 0x139874DDD8C6234CULL },
+    { 0x8F2D700AE4010BF1ULL, 0x1F5A549627A36BADULL }, { 0x0C2459A25000D65AULL, 0x191510781FB5EFBEULL },
+    { 0x701D1481D99A4515ULL, 0x1410D9F9B2F7F2FEULL }, { 0xC017439B147B6A77ULL, 0x100D7B2E28C65BFEULL },
+    { 0xCCF205C4ED9243F2ULL, 0x19AF2B7D0E0A2CCAULL }, { 0x0A5B37D0BE0E9CC2ULL, 0x148C22CA71A1BD6FULL },
+    { 0x0848F973CB3EE3CEULL, 0x10701BD527B4978CULL }, { 0xDA0E5BEC78649FB0ULL, 0x1A4CF9550C5425ACULL },
+    { 0x7B3EAFF060507FC0ULL, 0x150A6110D6A9B7BDULL }, { 0x95CBBFF380406633ULL, 0x10D51A73DEEE2C97ULL },
+    { 0xEFAC665266CD7052ULL, 0x1AEE90B964B04758ULL }, { 0x2623850EB8A459DBULL, 0x158BA6FAB6F36C47ULL },
+    { 0x1E82D0D893B6AE49ULL, 0x113C85955F29236CULL }, { 0xFD9E1AF41F8AB075ULL, 0x1B9408EEFEA838ACULL },
+    { 0x97B1AF29B2D559F7ULL, 0x16100725988693BDULL }, { 0xAC8E25BAF5777B2CULL, 0x11A66C1E139EDC97ULL },
+    { 0x7A7D092B2258C513ULL, 0x1C3D79C9B8FE2DBFULL }, { 0x61FDA0EF4EAD6A76ULL, 0x169794A160CB57CCULL },
+    { 0xE7FE1A590BBDEEC5ULL, 0x1212DD4DE7091309ULL }, { 0xA6635D5B45FCB13AULL, 0x1CEAFBAFD80E84DCULL },
+    { 0x851C4AAF6B308DC8ULL, 0x172262F3133ED0B0ULL }, { 0xD0E36EF2BC26D7D4ULL, 0x1281E8C275CBDA26ULL },
+    { 0xB49F17EAC6A48C86ULL, 0x1D9CA79D894629D7ULL }, { 0x2A18DFEF0550706BULL, 0x17B08617A104EE46ULL },
+    { 0x54E0B3259DD9F389ULL, 0x12F39E794D9D8B6BULL }, { 0x87CDEB6F62F65274ULL, 0x1E5297287C2F4578ULL },
+    { 0xD30B22BF825EA85DULL, 0x18421286C9BF6AC6ULL }, { 0x0F3C1BCC684BB9E4ULL, 0x13680ED23AFF889FULL },
+    { 0x18602C7A4079296DULL, 0x1F0CE4839198DA98ULL }, { 0x46B356C833942124ULL, 0x18D71D360E13E213ULL },
+    { 0x388F78A029434DB6ULL, 0x13DF4A91A4DCB4DCULL }, { 0x5A7F2766A86BAF8AULL, 0x1FCBAA82A1612160ULL },
+    { 0x153285EBB9EFBFA2ULL, 0x196FBB9BB44DB44DULL }, { 0xAA8ED189618C994EULL, 0x145962E2F6A4903DULL },
+    { 0xEED8A7A11AD6E10CULL, 0x1047824F2BB6D9CAULL }, { 0x7E27729B5E249B45ULL, 0x1A0C03B1DF8AF611ULL },
+    { 0xFE85F549181D4904ULL, 0x14D6695B193BF80DULL }, { 0xCB9E5DD4134AA0D0ULL, 0x10AB877C142FF9A4ULL },
+    { 0xDF63C9535211014DULL, 0x1AAC0BF9B9E65C3AULL }, { 0x191CA10F74DA6771ULL, 0x15566FFAFB1EB02FULL },
+    { 0xADB080D92A4852C1ULL, 0x1111F32F2F4BC025ULL }, { 0x15E7348EAA0D5134ULL, 0x1B4FEB7EB212CD09ULL },
+    { 0xAB1F5D3EEE710DC4ULL, 0x15D98932280F0A6DULL }, { 0xBC1917658B8DA49DULL, 0x117AD428200C0857ULL },
+    { 0x2CF4F23C127C3A94ULL, 0x1BF7B9D9CCE00D59ULL }, { 0xF0C3F4FCDB969543ULL, 0x165FC7E170B33DE0ULL },
+    { 0x5A365D9716121103ULL, 0x11E6398126F5CB1AULL }, { 0x9056FC24F01CE804ULL, 0x1CA38F350B22DE90ULL },
+    { 0xD9DF301D8CE3ECD0ULL, 0x16E93F5DA2824BA6ULL }, { 0xE17F59B13D8323DAULL, 0x125432B14ECEA2EBULL },
+    { 0x68CBC2B52F38395CULL, 0x1D53844EE47DD179ULL }, { 0x53D6355DBF602DE3ULL, 0x177603725064A794ULL },
+    { 0xA9782AB165E68B1CULL, 0x12C4CF8EA6B6EC76ULL }, { 0x0F26AAB56FD744FAULL, 0x1E07B27DD78B13F1ULL },
+    { 0x3F52222ABFDF6A62ULL, 0x18062864AC6F4327ULL }, { 0x65DB4E88997F884EULL, 0x1338205089F29C1FULL },
+    { 0x6FC54A7428CC0D4AULL, 0x1EC033B40FEA9365ULL }, { 0x596AA1F68709A43BULL, 0x1899C2F673220F84ULL },
+    { 0xADEEE7F86C07B696ULL, 0x13AE3591F5B4D936ULL }, { 0x497E3FF3E00C5756ULL, 0x1F7D228322BAF524ULL },
+    { 0xD464FFF64CD6AC45ULL, 0x1930E868E89590E9ULL }, { 0x4383FFF83D7889D1ULL, 0x14272053ED4473EEULL },
+    { 0xCF9CCCC69793A174ULL, 0x101F4D0FF1038FF1ULL }, { 0x7F6147A425B90252ULL, 0x19CBAE7FE805B31CULL },
+    { 0xCC4DD2E9B7C7350FULL, 0x14A2F1FFECD15C16ULL }, { 0x3D0B0F215FD290D9ULL, 0x10825B3323DAB012ULL },
+    { 0x61AB4B689950E7C1ULL, 0x1A6A2B85062AB350ULL }, { 0x4E22A2BA1440B967ULL, 0x1521BC6A6B555C40ULL },
+    { 0x0B4EE894DD009453ULL, 0x10E7C9EEBC4449CDULL }, { 0x1217DA87C800ED51ULL, 0x1B0C764AC6D3A948ULL },
+    { 0xDB46486CA000BDDAULL, 0x15A391D56BDC876CULL }, { 0x490506BD4CCD64AFULL, 0x114FA7DDEFE39F8AULL },
+    { 0xA8080AC87AE23AB1ULL, 0x1BB2A62FE638FF43ULL }, { 0x5339A239FBE82EF4ULL, 0x162884F31E93FF69ULL },
+    { 0x75C7B4FB2FECF25DULL, 0x11BA03F5B20FFF87ULL }, { 0x22D92191E647EA2EULL, 0x1C5CD322B67FFF3FULL },
+    { 0xB57A8141850654F2ULL, 0x16B0A8E891FFFF65ULL }, { 0xC4620101373843F5ULL, 0x1226ED86DB3332B7ULL },
+    { 0x3A366801F1F39FEEULL, 0x1D0B15A491EB8459ULL }, { 0xFB5EB99B27F6198BULL, 0x173C115074BC69E0ULL },
+    { 0x2F7EFAE2865E7AD6ULL, 0x129674405D6387E7ULL }, { 0xE597F7D0D6FD9156ULL, 0x1DBD86CD6238D971ULL },
+    { 0x8479930D78CADAABULL, 0x17CAD23DE82D7AC1ULL }, { 0xD06142712D6F1556ULL, 0x1308A831868AC89AULL },
+    { 0x4D686A4EAF182222ULL, 0x1E74404F3DAADA91ULL }, { 0xA453883EF279B4E8ULL, 0x185D003F6488AEDAULL },
+    { 0xE9DC6CFF28615D87ULL, 0x137D99CC506D58AEULL }, { 0xA960AE650D6895A4ULL, 0x1F2F5C7A1A488DE4ULL },
+    { 0xBAB3BEB73DED4483ULL, 0x18F2B061AEA07183ULL }, { 0x2EF6322C318A9D36ULL, 0x13F559E7BEE6C136ULL },
+    { 0xE4BD1D13827761F0ULL, 0x1FEEF63F97D79B89ULL }, { 0x83CA7DA9352C4E5AULL, 0x198BF832DFDFAFA1ULL },
+    { 0x9CA1FE20F756A515ULL, 0x146FF9C24CB2F2E7ULL }, { 0x4A1B31B3F9121DAAULL, 0x1059949B708F28B9ULL },
+    { 0x435EB5ECC1B695DDULL, 0x1A28EDC580E50DF5ULL }, { 0x35E55E57015EDE4AULL, 0x14ED8B04671DA4C4ULL },
+    { 0xC4B77EAC0118B1D5ULL, 0x10BE08D0527E1D69ULL }, { 0xA12597799B5AB622ULL, 0x1AC9A7B3B7302F0FULL },
+    { 0x4DB7AC6149155E81ULL, 0x156E1FC2F8F358D9ULL }, { 0xD7C6238107444B9BULL, 0x1124E63593F5E0ADULL },
+    { 0x593D059B3ED3AC2BULL, 0x1B6E3D2286563449ULL }, { 0xE0FD9E15CBDC89BCULL, 0x15F1CA820511C36DULL },
+    { 0xB3FE18116FE3A163ULL, 0x118E3B9B37416924ULL }, { 0x866359B57FD29BD1ULL, 0x1C16C5C525357507ULL },
+    { 0xD1E91491330EE30EULL, 0x16789E3750F790D2ULL }, { 0x74BA76DA8F3F1C0BULL, 0x11FA182C40C60D75ULL },
+    { 0xEDF72490E531C678ULL, 0x1CC359E067A348BBULL }, { 0x8B2C1D40B75B052DULL, 0x1702AE4D1FB5D3C9ULL },
+    { 0x6F567DCD5F7C0424ULL, 0x12688B70E62B0FD4ULL }, { 0x7EF0C94898C66D06ULL, 0x1D74124E3D11B2EDULL },
+    { 0x98C0A106E09EBD9FULL, 0x17900EA4FDA7C257ULL }, { 0x470080D24D4BCAE6ULL, 0x12D9A550CAEC9B79ULL },
+    { 0xD800CE1D487944A2ULL, 0x1E29088144ADC58EULL }, { 0x1333D8176D2DD082ULL, 0x1820D39A9D57D13FULL },
+    { 0xA8F646792424A6CEULL, 0x134D76154AACA765ULL }, { 0x74BD3D8EA03AA47DULL, 0x1EE25688777AA56FULL },
+    { 0x5D64313EE6955064ULL, 0x18B51206C5FBB78CULL }, { 0x4AB68DCBEBAAA6B7ULL, 0x13C40E6BD1962C70ULL },
+    { 0x1124161312AAA457ULL, 0x1FA01712E8F0471AULL }, { 0xDA8344DC0EEEE9DFULL, 0x194CDF4253F36C14ULL },
+    { 0xE2029D7CD8BF2180ULL, 0x143D7F6843292343ULL }, { 0x4E687DFD7A328133ULL, 0x103132B9CF541C36ULL },
+    { 0x4A40C9959050CEB8ULL, 0x19E851294BB9C6BDULL }, { 0x0833D477A6A70BC6ULL, 0x14B9DA876FC7D231ULL },
+    { 0xA02976C61EEC096BULL, 0x1094AED2BFD30E8DULL }, { 0x004257A364ACDBDFULL, 0x1A877E1DFFB81749ULL },
+    { 0xCD01DFB5EA23E319ULL, 0x153931B1996012A0ULL }, { 0x70CE4C91881CB5AEULL, 0x10FA8E27ADE6754DULL },
+    { 0x1AE3ADB5A69455E2ULL, 0x1B2A7D0C4970BBAFULL }, { 0x7BE957C4854377E8ULL, 0x15BB973D078D62F2ULL },
+    { 0xC987796A0435F987ULL, 0x1162DF64060AB58EULL }, { 0x75A58F1006BCC271ULL, 0x1BD1656CD67788E4ULL },
+    { 0xF7B7A5A66BCA3527ULL, 0x16411DF0AB92D3E9ULL }, { 0x5FC61E1EBCA1C41FULL, 0x11CDB18D560F0FEEULL },
+    { 0xFFA363646102D365ULL, 0x1C7C4F4889B1B316ULL }, { 0x32E91C504D9BDC51ULL, 0x16C9D906D48E28DFULL },
+    { 0x8F20E37371497D0EULL, 0x123B140576D820B2ULL }, { 0x7E9B0585820F2E7CULL, 0x1D2B533BF159CDEAULL },
+    { 0xCBAF379E01A5BECAULL, 0x1755DC2FF447D7EEULL }, { 0x0958F94B348498A1ULL, 0x12AB168CC36CACBFULL },
+};
+
+static sp_u64 const SafePrintPow5Split[326][2] = {
+    { 0x0000000000000000ULL, 0x1000000000000000ULL }, { 0x0000000000000000ULL, 0x1400000000000000ULL },
+    { 0x0000000000000000ULL, 0x1900000000000000ULL }, { 0x0000000000000000ULL, 0x1F40000000000000ULL },
+    { 0x0000000000000000ULL, 0x1388000000000000ULL }, { 0x0000000000000000ULL, 0x186A000000000000ULL },
+    { 0x0000000000000000ULL, 0x1E84800000000000ULL }, { 0x0000000000000000ULL, 0x1312D00000000000ULL },
+    { 0x0000000000000000ULL, 0x17D7840000000000ULL }, { 0x0000000000000000ULL, 0x1DCD650000000000ULL },
+    { 0x0000000000000000ULL, 0x12A05F2000000000ULL }, { 0x0000000000000000ULL, 0x174876E800000000ULL },
+    { 0x0000000000000000ULL, 0x1D1A94A200000000ULL }, { 0x0000000000000000ULL, 0x12309CE540000000ULL },
+    { 0x0000000000000000ULL, 0x16BCC41E90000000ULL }, { 0x0000000000000000ULL, 0x1C6BF52634000000ULL },
+    { 0x0000000000000000ULL, 0x11C37937E0800000ULL }, { 0x0000000000000000ULL, 0x16345785D8A00000ULL },
+    { 0x0000000000000000ULL, 0x1BC16D674EC80000ULL }, { 0x0000000000000000ULL, 0x1158E460913D0000ULL },
+    { 0x0000000000000000ULL, 0x15AF1D78B58C4000ULL }, { 0x0000000000000000ULL, 0x1B1AE4D6E2EF5000ULL },
+    { 0x0000000000000000ULL, 0x10F0CF064DD59200ULL }, { 0x0000000000000000ULL, 0x152D02C7E14AF680ULL },
+    { 0x0000000000000000ULL, 0x1A784379D99DB420ULL }, { 0x0000000000000000ULL, 0x108B2A2C28029094ULL },
+    { 0x0000000000000000ULL, 0x14ADF4B7320334B9ULL }, { 0x4000000000000000ULL, 0x19D971E4FE8401E7ULL },
+    { 0x8800000000000000ULL, 0x1027E72F1F128130ULL }, { 0xAA00000000000000ULL, 0x1431E0FAE6D7217CULL },
+    { 0xD480000000000000ULL, 0x193E5939A08CE9DBULL }, { 0xC9A0000000000000ULL, 0x1F8DEF8808B02452ULL },
+    { 0xBE04000000000000ULL, 0x13B8B5B5056E16B3ULL }, { 0xAD85000000000000ULL, 0x18A6E32246C99C60ULL },
+    { 0xD8E6400000000000ULL, 0x1ED09BEAD87C0378ULL }, { 0x878FE80000000000ULL, 0x13426172C74D822BULL },
+    { 0x6973E20000000000ULL, 0x1812F9CF7920E2B6ULL }, { 0x03D0DA8000000000ULL, 0x1E17B84357691B64ULL },
+    { 0x8262889000000000ULL, 0x12CED32A16A1B11EULL }, { 0x22FB2AB400000000ULL, 0x178287F49C4A1D66ULL },
+    { 0xABB9F56100000000ULL, 0x1D6329F1C35CA4BFULL }, { 0xCB54395CA0000000ULL, 0x125DFA371A19E6F7ULL },
+    { 0xBE2947B3C8000000ULL, 0x16F578C4E0A060B5ULL }, { 0x2DB399A0BA000000ULL, 0x1CB2D6F618C878E3ULL },
+    { 0xFC90400474400000ULL, 0x11EFC659CF7D4B8DULL }, { 0x7BB4500591500000ULL, 0x166BB7F0435C9E71ULL },
+    { 0xDAA16406F5A40000ULL, 0x1C06A5EC5433C60DULL }, { 0xA8A4DE8459868000ULL, 0x118427B3B4A05BC8ULL },
+    { 0xD2CE16256FE82000ULL, 0x15E531A0A1C872BAULL }, { 0x87819BAECBE22800ULL, 0x1B5E7E08CA3A8F69ULL },
+    { 0xF4B1014D3F6D5900ULL, 0x111B0EC57E6499A1ULL }, { 0x71DD41A08F48AF40ULL, 0x1561D276DDFDC00AULL },
+    { 0x0E549208B31ADB10ULL, 0x1ABA4714957D300DULL }, { 0x28F4DB456FF0C8EAULL, 0x10B46C6CDD6E3E08ULL },
+    { 0x33321216CBECFB24ULL, 0x14E1878814C9CD8AULL }, { 0xBFFE969C7EE839EDULL, 0x1A19E96A19FC40ECULL },
+    { 0xF7FF1E21CF512434ULL, 0x105031E2503DA893ULL }, { 0xF5FEE5AA43256D41ULL, 0x14643E5AE44D12B8ULL },
+    { 0x337E9F14D3EEC892ULL, 0x197D4DF19D605767ULL }, { 0x005E46DA08EA7AB6ULL, 0x1FDCA16E04B86D41ULL },
+    { 0xA03AEC4845928CB2ULL, 0x13E9E4E4C2F34448ULL }, { 0xC849A75A56F72FDEULL, 0x18E45E1DF3B0155AULL },
+    { 0x7A5C1130ECB4FBD6ULL, 0x1F1D75A5709C1AB1ULL }, { 0xEC798ABE93F11D65ULL, 0x13726987666190AEULL },
+    { 0xA797ED6E38ED64BFULL, 0x184F03E93FF9F4DAULL }, { 0x517DE8C9C728BDEFULL, 0x1E62C4E38FF87211ULL },
+    { 0xD2EEB17E1C7976B5ULL, 0x12FDBB0E39FB474AULL }, { 0x87AA5DDDA397D462ULL, 0x17BD29D1C87A191DULL },
+    { 0xE994F5550C7DC97BULL, 0x1DAC74463A989F64ULL }, { 0x11FD195527CE9DEDULL, 0x128BC8ABE49F639FULL },
+    { 0xD67C5FAA71C24568ULL, 0x172EBAD6DDC73C86ULL }, { 0x8C1B77950E32D6C2ULL, 0x1CFA698C95390BA8ULL },
+    { 0x57912ABD28DFC639ULL, 0x121C81F7DD43A749ULL }, { 0xAD75756C7317B7C8ULL, 0x16A3A275D494911BULL },
+    { 0x98D2D2C78FDDA5BAULL, 0x1C4C8B1349B9B562ULL }, { 0x9F83C3BCB9EA8794ULL, 0x11AFD6EC0E14115DULL },
+    { 0x0764B4ABE8652979ULL, 0x161BCCA7119915B5ULL }, { 0x493DE1D6E27E73D7ULL, 0x1BA2BFD0D5FF5B22ULL },
+    { 0x6DC6AD264D8F0866ULL, 0x1145B7E285BF98F5ULL }, { 0xC938586FE0F2CA80ULL, 0x159725DB272F7F32ULL },
+    { 0x7B866E8BD92F7D20ULL, 0x1AFCEF51F0FB5EFFULL }, { 0xAD34051767BDAE34ULL, 0x10DE1593369D1B5FULL },
+    { 0x9881065D41AD19C1ULL, 0x15159AF804446237ULL }, { 0x7EA147F492186032ULL, 0x1A5B01B605557AC5ULL },
+    { 0x6F24CCF8DB4F3C1FULL, 0x1078E111C3556CBBULL }, { 0x4AEE003712230B27ULL, 0x14971956342AC7EAULL },
+    { 0xDDA98044D6ABCDF0ULL, 0x19BCDFABC13579E4ULL }, { 0x0A89F02B062B60B6ULL, 0x10160BCB58C16C2FULL },
+    { 0xCD2C6C35C7B638E4ULL, 0x141B8EBE2EF1C73AULL }, { 0x8077874339A3C71DULL, 0x1922726DBAAE3909ULL },
+    { 0xE0956914080CB8E4ULL, 0x1F6B0F092959C74BULL }, { 0x6C5D61AC8507F38EULL, 0x13A2E965B9D81C8FULL },
+    { 0x4774BA17A649F072ULL, 0x188BA3BF284E23B3ULL }, { 0x1951E89D8FDC6C8FULL, 0x1EAE8CAEF261ACA0ULL },
+    { 0x0FD3316279E9C3D9ULL, 0x132D17ED577D0BE4ULL }, { 0x13C7FDBB186434CFULL, 0x17F85DE8AD5C4EDDULL },
+    { 0x58B9FD29DE7D4203ULL, 0x1DF67562D8B36294ULL }, { 0xB7743E3A2B0E4942ULL, 0x12BA095DC7701D9CULL },
+    { 0xE5514DC8B5D1DB92ULL, 0x17688BB5394C2503ULL }, { 0xDEA5A13AE3465277ULL, 0x1D42AEA2879F2E44ULL },
+    { 0x0B2784C4CE0BF38AULL, 0x1249AD2594C37CEBULL }, { 0xCDF165F6018EF06DULL, 0x16DC186EF9F45C25ULL },
+    { 0x416DBF7381F2AC88ULL, 0x1C931E8AB871732FULL }, { 0x88E497A83137ABD5ULL, 0x11DBF316B346E7FDULL },
+    { 0xEB1DBD923D8596CAULL, 0x1652EFDC6018A1FCULL }, { 0x25E52CF6CCE6FC7DULL, 0x1BE7ABD3781ECA7CULL },
+    { 0x97AF3C1A40105DCEULL, 0x1170CB642B133E8DULL }, { 0xFD9B0B20D0147542ULL, 0x15CCFE3D35D80E30ULL },
+    { 0x3D01CDE904199292ULL, 0x1B403DCC834E11BDULL }, { 0x462120B1A28FFB9BULL, 0x1108269FD210CB16ULL },
+    { 0xD7A968DE0B33FA82ULL, 0x154A3047C694FDDBULL }, { 0xCD93C3158E00F923ULL, 0x1A9CBC59B83A3D52ULL },
+    { 0xC07C59ED78C09BB6ULL, 0x10A1F5B813246653ULL }, { 0xB09B7068D6F0C2A3ULL, 0x14CA732617ED7FE8ULL },
+    { 0xDCC24C830CACF34CULL, 0x19FD0FEF9DE8DFE2ULL }, { 0xC9F96FD1E7EC180FULL, 0x103E29F5C2B18BEDULL },
+    { 0x3C77CBC661E71E13ULL, 0x144DB473335DEEE9ULL }, { 0x8B95BEB7FA60E598ULL, 0x1961219000356AA3ULL },
+    { 0x6E7B2E65F8F91EFEULL, 0x1FB969F40042C54CULL }, { 0xC50CFCFFBB9BB35FULL, 0x13D3E2388029BB4FULL },
+    { 0xB6503C3FAA82A037ULL, 0x18C8DAC6A0342A23ULL }, { 0xA3E44B4F95234844ULL, 0x1EFB1178484134ACULL },
+    { 0xE66EAF11BD360D2BULL, 0x135CEAEB2D28C0EBULL }, { 0xE00A5AD62C839075ULL, 0x183425A5F872F126ULL },
+    { 0x980CF18BB7A47493ULL, 0x1E412F0F768FAD70ULL }, { 0x5F0816F752C6C8DCULL, 0x12E8BD69AA19CC66ULL },
+    { 0xF6CA1CB527787B13ULL, 0x17A2ECC414A03F7FULL }, { 0xF47CA3E2715699D7ULL, 0x1D8BA7F519C84F5FULL },
+    { 0xF8CDE66D86D62026ULL, 0x127748F9301D319BULL }, { 0xF7016008E88BA830ULL, 0x17151B377C247E02ULL },
+    { 0xB4C1B80B22AE923CULL, 0x1CDA62055B2D9D83ULL }, { 0x50F91306F5AD1B65ULL, 0x12087D4358FC8272ULL },
+    { 0xE53757C8B318623FULL, 0x168A9C942F3BA30EULL }, { 0x9E852DBADFDE7ACFULL, 0x1C2D43B93B0A8BD2ULL },
+    { 0xA3133C94CBEB0CC1ULL, 0x119C4A53C4E69763ULL }, { 0x8BD80BB9FEE5CFF1ULL, 0x16035CE8B6203D3CULL },
+    { 0xAECE0EA87E9F43EEULL, 0x1B843422E3A84C8BULL }, { 0x4D40C9294F238A75ULL, 0x1132A095CE492FD7ULL },
+    { 0x2090FB73A2EC6D12ULL, 0x157F48BB41DB7BCDULL }, { 0x68B53A508BA78856ULL, 0x1ADF1AEA12525AC0ULL },
+    { 0x417144725748B536ULL, 0x10CB70D24B7378B8ULL }, { 0x51CD958EED1AE283ULL, 0x14FE4D06DE5056E6ULL },
+    { 0xE640FAF2A8619B24ULL, 0x1A3DE04895E46C9FULL }, { 0xEFE89CD7A93D00F7ULL, 0x1066AC2D5DAEC3E3ULL },
+    { 0xEBE2C40D938C4134ULL, 0x14805738B51A74DCULL }, { 0x26DB7510F86F5181ULL, 0x19A06D06E2611214ULL },
+    { 0x9849292A9B4592F1ULL, 0x100444244D7CAB4CULL }, { 0xBE5B73754216F7ADULL, 0x1405552D60DBD61FULL },
+    { 0xADF25052929CB598ULL, 0x1906AA78B912CBA7ULL }, { 0x996EE4673743E2FFULL, 0x1F485516E7577E91ULL },
+    { 0xFFE54EC0828A6DDFULL, 0x138D352E5096AF1AULL }, { 0xBFDEA270A32D0957ULL, 0x18708279E4BC5AE1ULL },
+    { 0x2FD64B0CCBF84BADULL, 0x1E8CA3185DEB719AULL }, { 0x5DE5EEE7FF7B2F4CULL, 0x1317E5EF3AB32700ULL },
+    { 0x755F6AA1FF59FB1FULL, 0x17DDDF6B095FF0C0ULL }, { 0x92B7454A7F3079E7ULL, 0x1DD55745CBB7ECF0ULL },
+    { 0x5BB28B4E8F7E4C30ULL, 0x12A5568B9F52F416ULL }, { 0xF29F2E22335DDF3CULL, 0x174EAC2E8727B11BULL },
+    { 0xEF46F9AAC035570BULL, 0x1D22573A28F19D62ULL }, { 0xD58C5C0AB8215667ULL, 0x123576845997025DULL },
+    { 0x4AEF730D6629AC01ULL, 0x16C2D4256FFCC2F5ULL }, { 0x9DAB4FD0BFB41701ULL, 0x1C73892ECBFBF3B2ULL },
+    { 0xA28B11E277D08E60ULL, 0x11C835BD3F7D784FULL }, { 0x8B2DD65B15C4B1F9ULL, 0x163A432C8F5CD663ULL },
+    { 0x6DF94BF1DB35DE77ULL, 0x1BC8D3F7B3340BFCULL }, { 0xC4BBCF772901AB0AULL, 0x115D847AD000877DULL },
+    { 0x35EAC354F34215CDULL, 0x15B4E5998400A95DULL }, { 0x8365742A30129B40ULL, 0x1B221EFFE500D3B4ULL },
+    { 0xD21F689A5E0BA108ULL, 0x10F5535FEF208450ULL }, { 0x06A742C0F58E894AULL, 0x1532A837EAE8A565ULL },
+    { 0x4851137132F22B9DULL, 0x1A7F5245E5A2CEBEULL }, { 0xED32AC26BFD75B42ULL, 0x108F936BAF85C136ULL },
+    { 0xA87F57306FCD3212ULL, 0x14B378469B673184ULL }, { 0xD29F2CFC8BC07E97ULL, 0x19E056584240FDE5ULL },
+    { 0xA3A37C1DD7584F1EULL, 0x102C35F729689EAFULL }, { 0x8C8C5B254D2E62E6ULL, 0x14374374F3C2C65BULL },
+    { 0x6FAF71EEA079FB9FULL, 0x1945145230B377F2ULL }, { 0x0B9B4E6A48987A87ULL, 0x1F965966BCE055EFULL },
+    { 0x674111026D5F4C94ULL, 0x13BDF7E0360C35B5ULL }, { 0xC111554308B71FBAULL, 0x18AD75D8438F4322ULL },
+    { 0x7155AA93CAE4E7A8ULL, 0x1ED8D34E547313EBULL }, { 0x26D58A9C5ECF10C9ULL, 0x13478410F4C7EC73ULL },
+    { 0xF08AED437682D4FBULL, 0x1819651531F9E78FULL }, { 0xECADA89454238A3AULL, 0x1E1FBE5A7E786173ULL },
+    { 0x73EC895CB4963664ULL, 0x12D3D6F88F0B3CE8ULL }, { 0x90E7ABB3E1BBC3FDULL, 0x1788CCB6B2CE0C22ULL },
+    { 0x352196A0DA2AB4FDULL, 0x1D6AFFE45F818F2BULL }, { 0x0134FE24885AB11EULL, 0x1262DFEEBBB0F97BULL },
+    { 0xC1823DADAA715D65ULL, 0x16FB97EA6A9D37D9ULL }, { 0x31E2CD19150DB4BFULL, 0x1CBA7DE5054485D0ULL },
+    { 0x1F2DC02FAD2890F7ULL, 0x11F48EAF234AD3A2ULL }, { 0xA6F9303B9872B535ULL, 0x1671B25AEC1D888AULL },
+    { 0x50B77C4A7E8F6282ULL, 0x1C0E1EF1A724EAADULL }, { 0x5272ADAE8F199D91ULL, 0x1188D357087712ACULL },
+    { 0x670F591A32E004F6ULL, 0x15EB082CCA94D757ULL }, { 0x40D32F60BF980633ULL, 0x1B65CA37FD3A0D2DULL },
+    { 0x4883FD9C77BF03E0ULL, 0x111F9E62FE44483CULL }, { 0x5AA4FD0395AEC4D8ULL, 0x156785FBBDD55A4BULL },
+    { 0x314E3C447B1A760EULL, 0x1AC1677AAD4AB0DEULL }, { 0xDED0E5AACCF089C9ULL, 0x10B8E0ACAC4EAE8AULL },
+    { 0x96851F15802CAC3BULL, 0x14E718D7D7625A2DULL }, { 0xFC2666DAE037D74AULL, 0x1A20DF0DCD3AF0B8ULL },
+    { 0x9D980048CC22E68EULL, 0x10548B68A044D673ULL }, { 0x84FE005AFF2BA032ULL, 0x1469AE42C8560C10ULL },
+    { 0xA63D8071BEF6883EULL, 0x198419D37A6B8F14ULL }, { 0xCFCCE08E2EB42A4EULL, 0x1FE52048590672D9ULL },
+    { 0x21E00C58DD309A70ULL, 0x13EF342D37A407C8ULL }, { 0x2A580F6F147CC10DULL, 0x18EB0138858D09BAULL },
+    { 0xB4EE134AD99BF150ULL, 0x1F25C186A6F04C28ULL }, { 0x7114CC0EC80176D2ULL, 0x137798F428562F99ULL },
+    { 0xCD59FF127A01D486ULL, 0x18557F31326BBB7FULL }, { 0xC0B07ED7188249A8ULL, 0x1E6ADEFD7F06AA5FULL },
+    { 0xD86E4F466F516E09ULL, 0x1302CB5E6F642A7BULL }, { 0xCE89E3180B25C98BULL, 0x17C37E360B3D351AULL },
+    { 0x822C5BDE0DEF3BEEULL, 0x1DB45DC38E0C8261ULL }, { 0xF15BB96AC8B58575ULL, 0x1290BA9A38C7D17CULL },
+    { 0x2DB2A7C57AE2E6D2ULL, 0x1734E940C6F9C5DCULL }, { 0x391F51B6D99BA086ULL, 0x1D022390F8B83753ULL },
+    { 0x03B3931248014454ULL, 0x1221563A9B732294ULL }, { 0x04A077D6DA019569ULL, 0x16A9ABC9424FEB39ULL },
+    { 0x45C895CC9081FAC3ULL, 0x1C5416BB92E3E607ULL }, { 0x8B9D5D9FDA513CBAULL, 0x11B48E353BCE6FC4ULL },
+    { 0xAE84B507D0E58BE8ULL, 0x1621B1C28AC20BB5ULL }, { 0x1A25E249C51EEEE3ULL, 0x1BAA1E332D728EA3ULL },
+    { 0xF057AD6E1B33554DULL, 0x114A52DFFC679925ULL }, { 0x6C6D98C9A2002AA1ULL, 0x159CE797FB817F6FULL },
+    { 0x4788FEFC0A803549ULL, 0x1B04217DFA61DF4BULL }, { 0x0CB59F5D8690214EULL, 0x10E294EEBC7D2B8FULL },
+    { 0xCFE30734E83429A1ULL, 0x151B3A2A6B9C7672ULL }, { 0x83DBC9022241340AULL, 0x1A6208B50683940FULL },
+    { 0xB2695DA15568C086ULL, 0x107D457124123C89ULL }, { 0x1F03B509AAC2F0A7ULL, 0x149C96CD6D16CBACULL },
+    { 0x26C4A24C1573ACD1ULL, 0x19C3BC80C85C7E97ULL }, { 0x783AE56F8D684C03ULL, 0x101A55D07D39CF1EULL },
+    { 0x16499ECB70C25F03ULL, 0x1420EB449C8842E6ULL }, { 0x9BDC067E4CF2F6C4ULL, 0x19292615C3AA539FULL },
+    { 0x82D3081DE02FB476ULL, 0x1F736F9B3494E887ULL }, { 0xB1C3E512AC1DD0C9ULL, 0x13A825C100DD1154ULL },
+    { 0xDE34DE57572544FCULL, 0x18922F31411455A9ULL }, { 0x55C215ED2CEE963BULL, 0x1EB6BAFD91596B14ULL },
+    { 0xB5994DB43C151DE5ULL, 0x133234DE7AD7E2ECULL }, { 0xE2FFA1214B1A655EULL, 0x17FEC216198DDBA7ULL },
+    { 0xDBBF89699DE0FEB6ULL, 0x1DFE729B9FF15291ULL }, { 0x2957B5E202AC9F31ULL, 0x12BF07A143F6D39BULL },
+    { 0xF3ADA35A8357C6FEULL, 0x176EC98994F48881ULL }, { 0x70990C31242DB8BDULL, 0x1D4A7BEBFA31AAA2ULL },
+    { 0x865FA79EB69C9376ULL, 0x124E8D737C5F0AA5ULL }, { 0xE7F791866443B854ULL, 0x16E230D05B76CD4EULL },
+    { 0xA1F575E7FD54A669ULL, 0x1C9ABD04725480A2ULL }, { 0xA53969B0FE54E801ULL, 0x11E0B622C774D065ULL },
+    { 0x0E87C41D3DEA2202ULL, 0x1658E3AB7952047FULL }, { 0xD229B5248D64AA82ULL, 0x1BEF1C9657A6859EULL },
+    { 0x435A1136D85EEA91ULL, 0x117571DDF6C81383ULL }, { 0x143095848E76A536ULL, 0x15D2CE55747A1864ULL },
+    { 0x193CBAE5B2144E83ULL, 0x1B4781EAD1989E7DULL }, { 0x2FC5F4CF8F4CB112ULL, 0x110CB132C2FF630EULL },
+    { 0xBBB77203731FDD56ULL, 0x154FDD7F73BF3BD1ULL }, { 0x2AA54E844FE7D4ACULL, 0x1AA3D4DF50AF0AC6ULL },
+    { 0xDAA75112B1F0E4EBULL, 0x10A6650B926D66BBULL }, { 0xD15125575E6D1E26ULL, 0x14CFFE4E7708C06AULL },
+    { 0x85A56EAD360865B0ULL, 0x1A03FDE214CAF085ULL }, { 0x7387652C41C53F8EULL, 0x10427EAD4CFED653ULL },
+    { 0x50693E7752368F71ULL, 0x14531E58A03E8BE8ULL }, { 0x64838E1526C4334EULL, 0x1967E5EEC84E2EE2ULL },
+    { 0xFDA4719A70754022ULL, 0x1FC1DF6A7A61BA9AULL }, { 0xDE86C70086494815ULL, 0x13D92BA28C7D14A0ULL },
+    { 0x162878C0A7DB9A1AULL, 0x18CF768B2F9C59C9ULL }, { 0x5BB296F0D1D280A1ULL, 0x1F03542DFB83703BULL },
+    { 0x194F9E5683239064ULL, 0x1362149CBD322625ULL }, { 0x5FA385EC23EC747EULL, 0x183A99C3EC7EAFAEULL },
+    { 0xF78C67672CE7919DULL, 0x1E494034E79E5B99ULL }, { 0x3AB7C0A07C10BB02ULL, 0x12EDC82110C2F940ULL },
+    { 0x4965B0C89B14E9C3ULL, 0x17A93A2954F3B790ULL }, { 0x5BBF1CFAC1DA2433ULL, 0x1D9388B3AA30A574ULL },
+    { 0xB957721CB92856A0ULL, 0x127C35704A5E6768ULL }, { 0xE7AD4EA3E7726C48ULL, 0x171B42CC5CF60142ULL },
+    { 0xA198A24CE14F075AULL, 0x1CE2137F74338193ULL }, { 0x44FF65700CD16498ULL, 0x120D4C2FA8A030FCULL },
+    { 0x563F3ECC1005BDBEULL, 0x16909F3B92C83D3BULL }, { 0x2BCF0E7F14072D2EULL, 0x1C34C70A777A4C8AULL },
+    { 0x5B61690F6C847C3DULL, 0x11A0FC668AAC6FD6ULL }, { 0xF239C35347A59B4CULL, 0x16093B802D578BCBULL },
+    { 0xEEC83428198F021FULL, 0x1B8B8A6038AD6EBEULL }, { 0x553D20990FF96153ULL, 0x1137367C236C6537ULL },
+    { 0x2A8C68BF53F7B9A8ULL, 0x1585041B2C477E85ULL }, { 0x752F82EF28F5A812ULL, 0x1AE64521F7595E26ULL },
+    { 0x093DB1D57999890BULL, 0x10CFEB353A97DAD8ULL }, { 0x0B8D1E4AD7FFEB4EULL, 0x1503E602893DD18EULL },
+    { 0x8E7065DD8DFFE622ULL, 0x1A44DF832B8D45F1ULL }, { 0xF9063FAA78BFEFD5ULL, 0x106B0BB1FB384BB6ULL },
+    { 0xB747CF9516EFEBCAULL, 0x1485CE9E7A065EA4ULL }, { 0xE519C37A5CABE6BDULL, 0x19A742461887F64DULL },
+    { 0xAF301A2C79EB7036ULL, 0x1008896BCF54F9F0ULL }, { 0xDAFC20B798664C43ULL, 0x140AABC6C32A386CULL },
+    { 0x11BB28E57E7FDF54ULL, 0x190D56B873F4C688ULL }, { 0x1629F31EDE1FD72AULL, 0x1F50AC6690F1F82AULL },
+    { 0x4DDA37F34AD3E67AULL, 0x13926BC01A973B1AULL }, { 0xE150C5F01D88E019ULL, 0x187706B0213D09E0ULL },
+    { 0x19A4F76C24EB181FULL, 0x1E94C85C298C4C59ULL }, { 0xB0071AA39712EF13ULL, 0x131CFD3999F7AFB7ULL },
+    { 0x9C08E14C7CD7AAD8ULL, 0x17E43C8800759BA5ULL }, { 0x030B199F9C0D958EULL, 0x1DDD4BAA0093028FULL },
+    { 0x61E6F003C1887D79ULL, 0x12AA4F4A405BE199ULL }, { 0xBA60AC04B1EA9CD7ULL, 0x1754E31CD072D9FFULL },
+    { 0xA8F8D705DE65440DULL, 0x1D2A1BE4048F907FULL }, { 0xC99B8663AAFF4A88ULL, 0x123A516E82D9BA4FULL },
+    { 0xBC0267FC95BF1D2AULL, 0x16C8E5CA239028E3ULL }, { 0xAB0301FBBB2EE474ULL, 0x1C7B1F3CAC74331CULL },
+    { 0xEAE1E13D54FD4EC9ULL, 0x11CCF385EBC89FF1ULL }, { 0x659A598CAA3CA27BULL, 0x1640306766BAC7EEULL },
+    { 0xFF00EFEFD4CBCB1AULL, 0x1BD03C81406979E9ULL }, { 0x3F6095F5E4FF5EF0ULL, 0x116225D0C841EC32ULL },
+    { 0xCF38BB735E3F36ACULL, 0x15BAAF44FA52673EULL }, { 0x8306EA5035CF0457ULL, 0x1B295B1638E7010EULL },
+    { 0x11E4527221A162B6ULL, 0x10F9D8EDE39060A9ULL }, { 0x565D670EAA09BB64ULL, 0x15384F295C7478D3ULL },
+    { 0x2BF4C0D2548C2A3DULL, 0x1A8662F3B3919708ULL }, { 0x1B78F88374D79A66ULL, 0x1093FDD8503AFE65ULL },
+    { 0x625736A4520D8100ULL, 0x14B8FD4E6449BDFEULL }, { 0xFAED044D6690E140ULL, 0x19E73CA1FD5C2D7DULL },
+    { 0xBCD422B0601A8CC8ULL, 0x103085E53E599C6EULL }, { 0x6C092B5C78212FFAULL, 0x143CA75E8DF0038AULL },
+    { 0x070B763396297BF8ULL, 0x194BD136316C046DULL }, { 0x48CE53C07BB3DAF6ULL, 0x1F9EC583BDC70588ULL },
+    { 0x2D80F4584D5068DAULL, 0x13C33B72569C6375ULL }, { 0x78E1316E60A48310ULL, 0x18B40A4EEC437C52ULL },
+};
+
+// NOTE: ceil(log2(5^e)) for e > 0, floor(log10(2^e)) and floor(log10(5^e)), exact in the used ranges.
+static sp_s32 safe_print_pow5_bits(sp_s32 e) { return (sp_s32)(((sp_u32)e * 1217359) >> 19) + 1; }
+static sp_s32 safe_print_log10_pow2(sp_s32 e) { return (sp_s32)(((sp_u32)e * 78913) >> 18); }
+static sp_s32 safe_print_log10_pow5(sp_s32 e) { return (sp_s32)(((sp_u32)e * 732923) >> 20); }
+
+static sp_b32 safe_print_is_multiple_of_pow5(sp_u64 value, sp_s32 p) {
+    sp_s32 count = 0;
+    while (value % 5 == 0) {
+        value /= 5;
+        count += 1;
+    }
+    
+    return count >= p;
 }
+
+// NOTE: (m * mul) >> j for the 128 bit mul, with j > 64.
+static sp_u64 safe_print_mul_shift_64(sp_u64 m, sp_u64 const *mul, sp_s32 j) {
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 low  = (unsigned __int128)m * mul[0];
+    unsigned __int128 high = (unsigned __int128)m * mul[1];
+    
+    return (sp_u64)(((low >> 64) + high) >> (j - 64));
+#else
+    sp_u64 products[2][2];
+    for (sp_s32 i = 0; i < 2; i += 1) {
+        sp_u64 a_low  = (sp_u32)m;
+        sp_u64 a_high = m >> 32;
+        sp_u64 b_low  = (sp_u32)mul[i];
+        sp_u64 b_high = mul[i] >> 32;
+        
+        sp_u64 low_low = a_low * b_low;
+        sp_u64 mid1 = a_high * b_low + (low_low >> 32);
+        sp_u64 mid2 = a_low * b_high + (sp_u32)mid1;
+        
+        products[i][0] = (mid2 << 32) | (sp_u32)low_low;
+        products[i][1] = a_high * b_high + (mid1 >> 32) + (mid2 >> 32);
+    }
+    
+    sp_u64 sum  = products[0][1] + products[1][0];
+    sp_u64 high = products[1][1] + (sum < products[0][1]);
+    sp_s32 shift = j - 64;
+    
+    return (high << (64 - shift)) | (sum >> shift);
 #endif
+}
+
+/*
+ * Turns the mantissa and exponent bits of a finite, non zero double into the shortest decimal
+ * digits * 10^exponent that rounds to it, picking the closest one if there are several.
+ */
+static void safe_print_double_to_decimal(sp_u64 ieee_mantissa, sp_u32 ieee_exponent, sp_u64 *digits, sp_s32 *exponent) {
+    sp_s32 e2;
+    sp_u64 m2;
+    if (ieee_exponent == 0) {
+        e2 = 1 - 1023 - 52 - 2;
+        m2 = ieee_mantissa;
+    } else {
+        e2 = (sp_s32)ieee_exponent - 1023 - 52 - 2;
+        m2 = ((sp_u64)1 << 52) | ieee_mantissa;
+    }
+    sp_b32 accept_bounds = (m2 & 1) == 0;
+    
+    // NOTE: The interval of numbers rounding to the double is [mm, mp] around mv, all scaled by 4.
+    sp_u64 mv = 4 * m2;
+    sp_u32 mm_shift = ieee_mantissa != 0 || ieee_exponent <= 1;
+    
+    sp_u64 vr, vp, vm;
+    sp_s32 e10;
+    sp_b32 vm_is_trailing_zeros = sp_false;
+    sp_b32 vr_is_trailing_zeros = sp_false;
+    if (e2 >= 0) {
+        sp_s32 q = safe_print_log10_pow2(e2) - (e2 > 3);
+        sp_s32 k = SAFE_PRINT_POW5_INV_BITCOUNT + safe_print_pow5_bits(q) - 1;
+        sp_s32 i = -e2 + q + k;
+        e10 = q;
+        
+        vr = safe_print_mul_shift_64(4 * m2, SafePrintPow5InvSplit[q], i);
+        vp = safe_print_mul_shift_64(4 * m2 + 2, SafePrintPow5InvSplit[q], i);
+        vm = safe_print_mul_shift_64(4 * m2 - 1 - mm_shift, SafePrintPow5InvSplit[q], i);
+        
+        if (q <= 21) {
+            if (mv % 5 == 0) {
+                vr_is_trailing_zeros = safe_print_is_multiple_of_pow5(mv, q);
+            } else if (accept_bounds) {
+                vm_is_trailing_zeros = safe_print_is_multiple_of_pow5(mv - 1 - mm_shift, q);
+            } else {
+                vp -= safe_print_is_multiple_of_pow5(mv + 2, q);
+            }
+        }
+    } else {
+        sp_s32 q = safe_print_log10_pow5(-e2) - (-e2 > 1);
+        sp_s32 i = -e2 - q;
+        sp_s32 k = safe_print_pow5_bits(i) - SAFE_PRINT_POW5_BITCOUNT;
+        sp_s32 j = q - k;
+        e10 = q + e2;
+        
+        vr = safe_print_mul_shift_64(4 * m2, SafePrintPow5Split[i], j);
+        vp = safe_print_mul_shift_64(4 * m2 + 2, SafePrintPow5Split[i], j);
+        vm = safe_print_mul_shift_64(4 * m2 - 1 - mm_shift, SafePrintPow5Split[i], j);
+        
+        if (q <= 1) {
+            vr_is_trailing_zeros = sp_true;
+            if (accept_bounds) {
+                vm_is_trailing_zeros = mm_shift == 1;
+            } else {
+                vp -= 1;
+            }
+        } else if (q < 63) {
+            vr_is_trailing_zeros = (mv & (((sp_u64)1 << q) - 1)) == 0;
+        }
+    }
+    
+    // NOTE: Remove digits as long as the interval still has a number with fewer digits.
+    sp_s32 removed = 0;
+    sp_u32 last_removed_digit = 0;
+    sp_u64 output;
+    if (vm_is_trailing_zeros || vr_is_trailing_zeros) {
+        while (vp / 10 > vm / 10) {
+            vm_is_trailing_zeros &= vm % 10 == 0;
+            vr_is_trailing_zeros &= last_removed_digit == 0;
+            last_removed_digit = (sp_u32)(vr % 10);
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed += 1;
+        }
+        if (vm_is_trailing_zeros) {
+            while (vm % 10 == 0) {
+                vr_is_trailing_zeros &= last_removed_digit == 0;
+                last_removed_digit = (sp_u32)(vr % 10);
+                vr /= 10;
+                vp /= 10;
+                vm /= 10;
+                removed += 1;
+            }
+        }
+        
+        // NOTE: Round to even if the exact number ends in 5 followed by zeros.
+        if (vr_is_trailing_zeros && last_removed_digit == 5 && vr % 2 == 0) last_removed_digit = 4;
+        
+        output = vr + ((vr == vm && (!accept_bounds || !vm_is_trailing_zeros)) || last_removed_digit >= 5);
+    } else {
+        sp_b32 round_up = sp_false;
+        if (vp / 100 > vm / 100) {
+            round_up = vr % 100 >= 50;
+            vr /= 100;
+            vp /= 100;
+            vm /= 100;
+            removed += 2;
+        }
+        while (vp / 10 > vm / 10) {
+            round_up = vr % 10 >= 5;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed += 1;
+        }
+        
+        output = vr + (vr == vm || round_up);
+    }
+    
+    *digits = output;
+    *exponent = e10 + removed;
+}
+
+/*
+ * The same for floats. Everything fits into 64 bits, so the tables only need 59 and 61 significant bits.
+ */
+#define SAFE_PRINT_FLOAT_POW5_INV_BITCOUNT 59
+#define SAFE_PRINT_FLOAT_POW5_BITCOUNT 61
+
+static sp_u64 const SafePrintFloatPow5InvSplit[31] = {
+    0x0800000000000001ULL, 0x0666666666666667ULL, 0x051EB851EB851EB9ULL, 0x04189374BC6A7EFAULL,
+    0x068DB8BAC710CB2AULL, 0x053E2D6238DA3C22ULL, 0x0431BDE82D7B634EULL, 0x06B5FCA6AF2BD216ULL,
+    0x055E63B88C230E78ULL, 0x044B82FA09B5A52DULL, 0x06DF37F675EF6EAEULL, 0x057F5FF85E592558ULL,
+    0x0465E6604B7A8447ULL, 0x0709709A125DA071ULL, 0x05A126E1A84AE6C1ULL, 0x0480EBE7B9D58567ULL,
+    0x0734ACA5F6226F0BULL, 0x05C3BD5191B525A3ULL, 0x049C97747490EAE9ULL, 0x0760F253EDB4AB0EULL,
+    0x05E72843249088D8ULL, 0x04B8ED0283A6D3E0ULL, 0x078E480405D7B966ULL, 0x060B6CD004AC9452ULL,
+    0x04D5F0A66A23A9DBULL, 0x07BCB43D769F762BULL, 0x063090312BB2C4EFULL, 0x04F3A68DBC8F03F3ULL,
+    0x07EC3DAF94180651ULL, 0x065697BFA9ACD1DAULL, 0x051212FFBAF0A7E2ULL,
+};
+
+static sp_u64 const SafePrintFloatPow5Split[47] = {
+    0x1000000000000000ULL, 0x1400000000000000ULL, 0x1900000000000000ULL, 0x1F40000000000000ULL,
+    0x1388000000000000ULL, 0x186A000000000000ULL, 0x1E84800000000000ULL, 0x1312D00000000000ULL,
+    0x17D7840000000000ULL, 0x1DCD650000000000ULL, 0x12A05F2000000000ULL, 0x174876E800000000ULL,
+    0x1D1A94A200000000ULL, 0x12309CE540000000ULL, 0x16BCC41E90000000ULL, 0x1C6BF52634000000ULL,
+    0x11C37937E0800000ULL, 0x16345785D8A00000ULL, 0x1BC16D674EC80000ULL, 0x1158E460913D0000ULL,
+    0x15AF1D78B58C4000ULL, 0x1B1AE4D6E2EF5000ULL, 0x10F0CF064DD59200ULL, 0x152D02C7E14AF680ULL,
+    0x1A784379D99DB420ULL, 0x108B2A2C28029094ULL, 0x14ADF4B7320334B9ULL, 0x19D971E4FE8401E7ULL,
+    0x1027E72F1F128130ULL, 0x1431E0FAE6D7217CULL, 0x193E5939A08CE9DBULL, 0x1F8DEF8808B02452ULL,
+    0x13B8B5B5056E16B3ULL, 0x18A6E32246C99C60ULL, 0x1ED09BEAD87C0378ULL, 0x13426172C74D822BULL,
+    0x1812F9CF7920E2B6ULL, 0x1E17B84357691B64ULL, 0x12CED32A16A1B11EULL, 0x178287F49C4A1D66ULL,
+    0x1D6329F1C35CA4BFULL, 0x125DFA371A19E6F7ULL, 0x16F578C4E0A060B5ULL, 0x1CB2D6F618C878E3ULL,
+    0x11EFC659CF7D4B8DULL, 0x166BB7F0435C9E71ULL, 0x1C06A5EC5433C60DULL,
+};
+
+static sp_b32 safe_print_is_multiple_of_pow5_32(sp_u32 value, sp_s32 p) {
+    sp_s32 count = 0;
+    while (value % 5 == 0) {
+        value /= 5;
+        count += 1;
+    }
+    
+    return count >= p;
+}
+
+// NOTE: (m * factor) >> shift, with shift > 32.
+static sp_u32 safe_print_mul_shift_32(sp_u32 m, sp_u64 factor, sp_s32 shift) {
+    sp_u64 low  = (sp_u64)m * (sp_u32)factor;
+    sp_u64 high = (sp_u64)m * (factor >> 32);
+    
+    return (sp_u32)(((low >> 32) + high) >> (shift - 32));
+}
+
+static void safe_print_float_to_decimal(sp_u32 ieee_mantissa, sp_u32 ieee_exponent, sp_u32 *digits, sp_s32 *exponent) {
+    sp_s32 e2;
+    sp_u32 m2;
+    if (ieee_exponent == 0) {
+        e2 = 1 - 127 - 23 - 2;
+        m2 = ieee_mantissa;
+    } else {
+        e2 = (sp_s32)ieee_exponent - 127 - 23 - 2;
+        m2 = (1u << 23) | ieee_mantissa;
+    }
+    sp_b32 accept_bounds = (m2 & 1) == 0;
+    
+    sp_u32 mv = 4 * m2;
+    sp_u32 mp = 4 * m2 + 2;
+    sp_u32 mm_shift = ieee_mantissa != 0 || ieee_exponent <= 1;
+    sp_u32 mm = 4 * m2 - 1 - mm_shift;
+    
+    sp_u32 vr, vp, vm;
+    sp_s32 e10;
+    sp_b32 vm_is_trailing_zeros = sp_false;
+    sp_b32 vr_is_trailing_zeros = sp_false;
+    sp_u32 last_removed_digit = 0;
+    if (e2 >= 0) {
+        sp_s32 q = safe_print_log10_pow2(e2);
+        sp_s32 k = SAFE_PRINT_FLOAT_POW5_INV_BITCOUNT + safe_print_pow5_bits(q) - 1;
+        sp_s32 i = -e2 + q + k;
+        e10 = q;
+        
+        vr = safe_print_mul_shift_32(mv, SafePrintFloatPow5InvSplit[q], i);
+        vp = safe_print_mul_shift_32(mp, SafePrintFloatPow5InvSplit[q], i);
+        vm = safe_print_mul_shift_32(mm, SafePrintFloatPow5InvSplit[q], i);
+        
+        // NOTE: The loop below might not remove a digit, but the rounding needs the last removed one.
+        if (q != 0 && (vp - 1) / 10 <= vm / 10) {
+            sp_s32 l = SAFE_PRINT_FLOAT_POW5_INV_BITCOUNT + safe_print_pow5_bits(q - 1) - 1;
+            last_removed_digit = safe_print_mul_shift_32(mv, SafePrintFloatPow5InvSplit[q - 1], -e2 + q - 1 + l) % 10;
+        }
+        
+        if (q <= 9) {
+            if (mv % 5 == 0) {
+                vr_is_trailing_zeros = safe_print_is_multiple_of_pow5_32(mv, q);
+            } else if (accept_bounds) {
+                vm_is_trailing_zeros = safe_print_is_multiple_of_pow5_32(mm, q);
+            } else {
+                vp -= safe_print_is_multiple_of_pow5_32(mp, q);
+            }
+        }
+    } else {
+        sp_s32 q = safe_print_log10_pow5(-e2);
+        sp_s32 i = -e2 - q;
+        sp_s32 k = safe_print_pow5_bits(i) - SAFE_PRINT_FLOAT_POW5_BITCOUNT;
+        sp_s32 j = q - k;
+        e10 = q + e2;
+        
+        vr = safe_print_mul_shift_32(mv, SafePrintFloatPow5Split[i], j);
+        vp = safe_print_mul_shift_32(mp, SafePrintFloatPow5Split[i], j);
+        vm = safe_print_mul_shift_32(mm, SafePrintFloatPow5Split[i], j);
+        
+        if (q != 0 && (vp - 1) / 10 <= vm / 10) {
+            j = q - 1 - (safe_print_pow5_bits(i + 1) - SAFE_PRINT_FLOAT_POW5_BITCOUNT);
+            last_removed_digit = safe_print_mul_shift_32(mv, SafePrintFloatPow5Split[i + 1], j) % 10;
+        }
+        
+        if (q <= 1) {
+            vr_is_trailing_zeros = sp_true;
+            if (accept_bounds) {
+                vm_is_trailing_zeros = mm_shift == 1;
+            } else {
+                vp -= 1;
+            }
+        } else if (q < 31) {
+            vr_is_trailing_zeros = (mv & ((1u << (q - 1)) - 1)) == 0;
+        }
+    }
+    
+    sp_s32 removed = 0;
+    sp_u32 output;
+    if (vm_is_trailing_zeros || vr_is_trailing_zeros) {
+        while (vp / 10 > vm / 10) {
+            vm_is_trailing_zeros &= vm % 10 == 0;
+            vr_is_trailing_zeros &= last_removed_digit == 0;
+            last_removed_digit = vr % 10;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed += 1;
+        }
+        if (vm_is_trailing_zeros) {
+            while (vm % 10 == 0) {
+                vr_is_trailing_zeros &= last_removed_digit == 0;
+                last_removed_digit = vr % 10;
+                vr /= 10;
+                vp /= 10;
+                vm /= 10;
+                removed += 1;
+            }
+        }
+        
+        if (vr_is_trailing_zeros && last_removed_digit == 5 && vr % 2 == 0) last_removed_digit = 4;
+        
+        output = vr + ((vr == vm && (!accept_bounds || !vm_is_trailing_zeros)) || last_removed_digit >= 5);
+    } else {
+        while (vp / 10 > vm / 10) {
+            last_removed_digit = vr % 10;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed += 1;
+        }
+        
+        output = vr + (vr == vm || last_removed_digit >= 5);
+    }
+    
+    *digits = output;
+    *exponent = e10 + removed;
+}
 
+#endif // !defined(SAFE_PRINT_USE_OWN_FLOAT_CONVERSION)
+
+#ifdef __cplusplus
+}
 #endif
 
+#endif // defined(SAFE_PRINT_IMPLEMENTATION)